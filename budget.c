@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+
+const char *map_file = "grazers.map";
+const char *asm_file = "main.asm";
+const char *source = "main.c";
+const char *budgets = "budget.txt";
+
+enum { ROM, RAM, HEADROOM, SPARE, MAP, VRAM, TOP, STACK, ITEMS };
+
+/* headroom and spare are lower limits, every other budget an upper one */
+static const char *items[ITEMS] = {
+    "rom", "ram", "headroom", "spare", "map", "vram", "top", "stack",
+};
+
+static int limit[ITEMS];
+static int value[ITEMS];
+
+struct Asset {
+    char name[64];
+    int size;
+    int bank;
+    int slot;
+};
+
+static struct Asset assets[64];
+static int count;
+
+static int is_ram(const char *area) {
+    return strcmp(area, "_DATA") == 0 || strcmp(area, "_INITIALIZED") == 0
+	|| strcmp(area, "DATA") == 0 || strcmp(area, "BSS") == 0;
+}
+
+static int ends_with(const char *name, const char *suffix) {
+    int n = strlen(name), k = strlen(suffix);
+    return n > k && strcmp(name + n - k, suffix) == 0;
+}
+
+static struct Asset *lookup(const char *name) {
+    for (int i = 0; i < count; i++) {
+	if (strcmp(assets[i].name, name) == 0) return assets + i;
+    }
+    return NULL;
+}
+
+static struct Asset *find(const char *name) {
+    struct Asset *known = lookup(name);
+    if (known != NULL) return known;
+    if (count == 64) {
+	printf("ERROR too many assets\n");
+	exit(-EFBIG);
+    }
+    struct Asset *asset = assets + count++;
+    memset(asset, 0, sizeof(*asset));
+    strcpy(asset->name, name);
+    asset->bank = -1;
+    return asset;
+}
+
+/* TARGET: item limit, TARGET-B: lines override them in banked builds */
+static void read_budgets(const char *target, int banked) {
+    char line[256], word[64], item[64], own[64];
+    FILE *f = fopen(budgets, "r");
+    if (f == NULL) {
+	printf("ERROR \"%s\" not found\n", budgets);
+	exit(-ENOENT);
+    }
+    for (int pass = 0; pass <= banked; pass++) {
+	sprintf(own, pass ? "%s-B:" : "%s:", target);
+	rewind(f);
+	while (fgets(line, sizeof(line), f)) {
+	    char number[64];
+	    if (sscanf(line, "%63s %63s %63s", word, item, number) != 3) continue;
+	    if (strcmp(word, own) != 0) continue;
+	    for (int i = 0; i < ITEMS; i++) {
+		if (strcmp(item, items[i]) == 0) limit[i] = strtol(number, NULL, 0);
+	    }
+	}
+    }
+    fclose(f);
+}
+
+/* area lines: name address size = decimal. bytes (attributes) */
+static void read_map(void) {
+    char line[256], area[64];
+    unsigned addr, size, ram_end = 0;
+    FILE *f = fopen(map_file, "r");
+    if (f == NULL) {
+	printf("ERROR \"%s\" not found\n", map_file);
+	exit(-ENOENT);
+    }
+    while (fgets(line, sizeof(line), f)) {
+	if (line[0] == ' ' || line[0] == '\t') continue;
+	if (sscanf(line, "%63s %x %x =", area, &addr, &size) != 3) continue;
+	if (size == 0 || strcmp(area, "ZP") == 0) continue;
+	printf("AREA %-16s %04x %5d\n", area, addr, size);
+	if (is_ram(area)) {
+	    value[RAM] += size;
+	    if (addr + size > ram_end) ram_end = addr + size;
+	}
+	else {
+	    value[ROM] += size;
+	}
+    }
+    fclose(f);
+    value[HEADROOM] = limit[STACK] - (int) ram_end;
+    value[SPARE] = limit[ROM] - value[ROM];
+    value[TOP] = ram_end + limit[HEADROOM];
+    if (limit[STACK] > value[TOP]) value[TOP] = limit[STACK];
+    printf("RAM ends at %04x, stack at %04x\n", ram_end, limit[STACK]);
+}
+
+/* statics are not in the map, main.asm has them as _name: .ds size */
+static void read_variables(void) {
+    char line[256], name[64] = "";
+    FILE *f = fopen(asm_file, "r");
+    if (f == NULL) return;
+    while (fgets(line, sizeof(line), f)) {
+	int size;
+	if (line[0] == '_' && strchr(line, ':')) {
+	    sscanf(line, "_%63[^:]", name);
+	}
+	else if (sscanf(line, " .ds %i", &size) == 1 && name[0] && size >= 64) {
+	    printf("VAR %-16s %5d\n", name, size);
+	    name[0] = 0;
+	}
+    }
+    fclose(f);
+}
+
+/* stack top of the target from its SETUP_STACK() in main.c */
+static void read_stack(const char *target) {
+    char line[256], def[64] = "";
+    unsigned sp;
+    FILE *f = fopen(source, "r");
+    if (f == NULL) return;
+    while (fgets(line, sizeof(line), f)) {
+	sscanf(line, "#ifdef %63s", def);
+	char *ptr = strstr(line, "ld sp, #");
+	if (strncmp(line, "#define SETUP_STACK", 19) != 0 || ptr == NULL) continue;
+	if (strcmp(def, target) == 0 && sscanf(ptr + 8, "%x", &sp) == 1) {
+	    limit[STACK] = sp;
+	}
+    }
+    fclose(f);
+}
+
+/* pcx-dump data.h: extern or __at() arrays, name_bank and name_slot */
+static void read_assets(const char *target) {
+    char path[256], line[256], name[64];
+    int size, number;
+    sprintf(path, "assets/%s/data.h", target);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+	printf("ERROR \"%s\" not found\n", path);
+	exit(-ENOENT);
+    }
+    while (fgets(line, sizeof(line), f)) {
+	char *ptr = strstr(line, "const byte ");
+	if (ptr && sscanf(ptr + 11, "%63[^[][%d]", name, &size) == 2) {
+	    find(name)->size = size;
+	}
+	if (sscanf(line, "#define %63s %d", name, &number) != 2) continue;
+	if (ends_with(name, "_bank")) {
+	    name[strlen(name) - 5] = 0;
+	    find(name)->bank = number;
+	}
+	if (ends_with(name, "_slot")) {
+	    name[strlen(name) - 5] = 0;
+	    find(name)->slot = number;
+	}
+    }
+    fclose(f);
+}
+
+static void report_assets(const char *target) {
+    int sms = strcmp(target, "SMS") == 0;
+    int uploads = sms || strcmp(target, "MSX") == 0;
+    for (int i = 0; i < count; i++) {
+	struct Asset *asset = assets + i;
+	const char *kind = "TILES";
+	if (ends_with(asset->name, "_map")) kind = "MAP";
+	if (ends_with(asset->name, "_color")) kind = "COLOR";
+	printf("%-5s %-16s %5d", kind, asset->name, asset->size);
+	if (asset->bank >= 0) printf(" bank %d", asset->bank);
+	if (kind[0] == 'M' && asset->size > value[MAP]) value[MAP] = asset->size;
+	if (kind[0] == 'T' && uploads) {
+	    int end = asset->slot + asset->size / (sms ? 32 : 8);
+	    printf(" vram %d-%d", asset->slot, end - 1);
+	    if (end > value[VRAM]) value[VRAM] = end;
+	}
+	printf("\n");
+    }
+}
+
+static int check(void) {
+    int failed = 0;
+    for (int i = 0; i < STACK; i++) {
+	if (limit[i] == 0) continue;
+	int lower = i == HEADROOM || i == SPARE;
+	int over = lower ? value[i] < limit[i] : value[i] > limit[i];
+	printf("%s %s %d of %d\n", over ? "OVER" : "BUDGET",
+	       items[i], value[i], limit[i]);
+	failed |= over;
+    }
+    return failed;
+}
+
+/* usage: budget [-B] target */
+int main(int argc, char **argv) {
+    int banked = argc > 2 && strcmp(argv[1], "-B") == 0;
+    if (argc < 2 + banked) {
+	printf("usage: %s [-B] target\n", argv[0]);
+	return -1;
+    }
+    const char *target = argv[1 + banked];
+
+    read_stack(target);
+    read_budgets(target, banked);
+    read_map();
+    read_variables();
+    read_assets(target);
+    report_assets(target);
+
+    if (check()) {
+	printf("ERROR %s over budget\n", target);
+	return -EFBIG;
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+extern const byte tiles[320];
+extern const byte tiles_color[40];
+extern const byte fence[544];
+extern const byte fence_color[68];
+extern const byte dialog_map[28];
+extern const byte quarantine_map[114];
+extern const byte gardener_map[580];
+extern const byte earthquake_map[559];
+extern const byte flooding_map[290];
+extern const byte tsunami_map[193];
+extern const byte equilibrium_map[276];
+extern const byte migration_map[241];
+extern const byte aridness_map[396];
+extern const byte lonesome_map[177];
+extern const byte eruption_map[360];
+extern const byte fertility_map[476];
+extern const byte erosion_map[469];
+extern const byte logo[664];
+extern const byte logo_color[83];
+extern const byte logo_map[172];
+extern const byte sunset[1552];
+extern const byte sunset_color[194];
+extern const byte sunset_map[426];
+extern const byte volcano[608];
+extern const byte volcano_color[76];
+extern const byte volcano_map[165];
@@ -27,6 +27,14 @@ static void msx_prefix(void) __naked {
     __asm__("out (#0xa8), a");
     __asm__("ei");
 
+#ifdef BANKED
+    __asm__("ld a, #1");	/* ASCII8 mapper: code in 0x4000-0x9fff */
+    __asm__("ld (#0x6800), a");
+    __asm__("inc a");
+    __asm__("ld (#0x7000), a");
+    __asm__("inc a");
+    __asm__("ld (#0x7800), a");
+#endif
     __asm__("jp _reset");
 }
 #endif
@@ -46,9 +54,11 @@ static void rom_start(void) __naked {
     __asm__("push bc");
     __asm__("push de");
     __asm__("push hl");
+    __asm__("push iy");
 
     __asm__("call _vdp_update");
 
+    __asm__("pop iy");
     __asm__("pop hl");
     __asm__("pop de");
     __asm__("pop bc");
@@ -59,11 +69,17 @@ static void rom_start(void) __naked {
     __asm__("ret");
     __asm__("rom_irq_end:");
     __asm__(".blkb 0x66 - (rom_irq_end - _rom_start)");
+
+    __asm__("push af");		/* PAUSE button */
+    __asm__("ld a, #1");
+    __asm__("ld (_paused), a");
+    __asm__("pop af");
     __asm__("retn");
 }
 #endif
 
 #include "data.h"
+#include "terrain.h"
 
 #define ADDR(obj)	((word) (obj))
 #define BYTE(addr)	(* (volatile byte *) (addr))
@@ -80,6 +96,9 @@ static void rom_start(void) __naked {
 #define FONT_ADDR	0x3c00
 #define FLASH_ADDR	0x5900
 #define FLASH_INC	32
+#define EPOCH_FRAMES	3
+#define FRAME_CYCLES	69888L
+#define CELL_CYCLES	1100
 #endif
 
 #ifdef C64
@@ -92,18 +111,27 @@ static void rom_start(void) __naked {
 #define FONT_ADDR	0x7c00
 #define FLASH_ADDR	0x8d44
 #define FLASH_INC	40
+#define EPOCH_FRAMES	3
+#define FRAME_CYCLES	19656L
+#define CELL_CYCLES	900
 #endif
 
 #ifdef SMS
 #define NOTE(freq)	((word) (125000.0 / freq))
 #define SCALE_HI(n, x)	((n) >> (x))
 #define SCALE_LO(n, x)	((n) << (x))
+#define EPOCH_FRAMES	4
+#define FRAME_CYCLES	59736L
+#define CELL_CYCLES	1100
 #endif
 
 #ifdef MSX
 #define NOTE(freq)	((word) (1789772.5 / (16.0 * freq)))
 #define SCALE_HI(n, x)	((n) >> (x))
 #define SCALE_LO(n, x)	((n) << (x))
+#define EPOCH_FRAMES	4
+#define FRAME_CYCLES	59736L
+#define CELL_CYCLES	1100
 #endif
 
 #ifdef C64
@@ -143,6 +171,7 @@ static void rom_start(void) __naked {
 #endif
 
 #ifdef SMS
+/* 0xdff0-0xdfff is kept free, the mapper at 0xfffc-0xffff mirrors there */
 #define SETUP_STACK()	__asm__("ld sp, #0xdff0")
 #endif
 
@@ -166,8 +195,20 @@ void sdcc_deps(void) __naked {
 #endif
 
 static volatile byte vblank;
+#ifdef SMS
+static volatile byte paused;
+#endif
 static byte *map_y[192];
 
+#define DIALOG		POS(0, 10)
+#define DIALOG_END	POS(0, 13)
+
+/* level setup on retry only draws what the dialog covered */
+static byte retry;
+static byte hidden(word n) {
+    return retry && (n < DIALOG || n >= DIALOG_END);
+}
+
 static byte forest[0x2e0];
 
 static byte *update[512];
@@ -180,7 +221,29 @@ static byte steps;
 static byte wasd;
 static byte reduce;
 
-struct Level { void (*fn)(void); };
+struct Level { void (*fn)(void); byte bank; byte rewind; };
+
+#if defined(BANKED) && defined(SMS)
+#define BANK(data)	data##_bank
+#define MAP_BANK(n)	{ vdp_upload_wait(); BYTE(0xffff) = (n); }
+#elif defined(BANKED) && defined(MSX)
+#define BANK(data)	data##_bank
+#define MAP_BANK(n)	BYTE(0x7800) = (n)
+#elif defined(BANKED) && defined(C64)
+#define BANK(data)	data##_bank
+#define MAP_BANK(n)	stream_bank(n)
+#define PREFETCH(n)	STREAM_NEXT = (n)
+#define FETCH()		stream_bank(STREAM_NEXT)
+static void stream_bank(byte n);
+#else
+#define BANK(data)	0
+#define MAP_BANK(n)
+#endif
+
+#ifndef PREFETCH
+#define PREFETCH(n)	MAP_BANK(n)
+#define FETCH()
+#endif
 
 void reset(void);
 
@@ -198,13 +261,86 @@ static void __sdcc_call_hl(void) __naked {
 }
 #endif
 
+#ifdef C64
 static void memset(byte *ptr, byte data, word len) {
-    while (len-- > 0) { *ptr++ = data; }
+    for (byte pages = len >> 8; pages > 0; pages--) {
+	byte i = 0;
+	do { ptr[i] = data; } while (++i != 0);
+	ptr += 0x100;
+    }
+    for (byte i = 0; i < (byte) len; i++) { ptr[i] = data; }
 }
 
 static void memcpy(byte *dst, byte *src, word len) {
-    while (len-- > 0) { *dst++ = *src++; }
+    for (byte pages = len >> 8; pages > 0; pages--) {
+	byte i = 0;
+	do { dst[i] = src[i]; } while (++i != 0);
+	dst += 0x100;
+	src += 0x100;
+    }
+    for (byte i = 0; i < (byte) len; i++) { dst[i] = src[i]; }
+}
+#else
+/* LDIR is 21 T-states a byte, a C byte loop is at least 39 */
+static void memset(byte *ptr, byte data, word len) {
+    __asm__("push iy"); ptr;
+    __asm__("ld iy, #4");
+    __asm__("add iy, sp");
+    __asm__("ld e, (iy)"); data;
+    __asm__("ld c, 1 (iy)"); len;
+    __asm__("ld b, 2 (iy)");
+    __asm__("pop iy");
+    __asm__("ld a, b");
+    __asm__("or a, c");
+    __asm__("jr z, fill_done");
+    __asm__("ld (hl), e");
+    __asm__("dec bc");
+    __asm__("ld a, b");
+    __asm__("or a, c");
+    __asm__("jr z, fill_done");
+    __asm__("ld d, h");
+    __asm__("ld e, l");
+    __asm__("inc de");
+    __asm__("ldir");
+    __asm__("fill_done:");
+}
+
+/* 8 LDI and a JP PE is 138 T-states, 17.25 a byte against LDIR's 21 */
+static void memcpy(byte *dst, byte *src, word len) {
+    __asm__("push iy");
+    __asm__("ld iy, #4");
+    __asm__("add iy, sp");
+    __asm__("ld c, (iy)"); len;
+    __asm__("ld b, 1 (iy)");
+    __asm__("pop iy");
+    __asm__("ex de, hl"); dst; src;
+    __asm__("ld a, c");
+    __asm__("and #7");
+    __asm__("jr z, copy_eights");
+    __asm__("push bc");
+    __asm__("ld b, #0");
+    __asm__("ld c, a");
+    __asm__("ldir");
+    __asm__("pop bc");
+    __asm__("copy_eights:");
+    __asm__("ld a, c");
+    __asm__("and #0xf8");
+    __asm__("ld c, a");
+    __asm__("or a, b");
+    __asm__("jr z, copy_done");
+    __asm__("copy_loop:");
+    __asm__("ldi");
+    __asm__("ldi");
+    __asm__("ldi");
+    __asm__("ldi");
+    __asm__("ldi");
+    __asm__("ldi");
+    __asm__("ldi");
+    __asm__("ldi");
+    __asm__("jp pe, copy_loop");
+    __asm__("copy_done:");
 }
+#endif
 
 #if defined(ZXS) || defined(MSX)
 static void interrupt(void) __naked {
@@ -282,10 +418,10 @@ static const byte sms_palette[] = {
     0x1b, 0x10, 0x24, 0x38,
     0x00, 0x15, 0x2a, 0x3f,
 
-    0x00, 0x00, 0x00, 0x00,
+    0x00, 0x06, 0x1b, 0x00,
     0x0f, 0x01, 0x02, 0x03,
     0x10, 0x24, 0x38, 0x3c,
-    0x00, 0x00, 0x00, 0x00,
+    0x00, 0x15, 0x2a, 0x3f,
 };
 
 static void vdp_switch(byte value) {
@@ -352,22 +488,67 @@ static void vdp_memcpy(word dst, byte *src, word count) {
 
 static word vdp_addr[256];
 static word vdp_data[256];
-static byte vdp_head, vdp_tail;
+static volatile byte vdp_head, vdp_tail;
 
 static void vdp_put_tile(word n, word tile) {
     if (!vdp_state) {
 	vdp_word(0x7800 + (n << 1), tile);
     }
     else {
-	while (vdp_head + 1 == vdp_tail) { }
+	while ((byte) (vdp_head + 1) == vdp_tail) { }
 	vdp_addr[vdp_head] = 0x7800 + (n << 1);
 	vdp_data[vdp_head] = tile;
 	vdp_head++;
     }
 }
 
+/* tile data streams a chunk per vblank and holds back the tile queue,
+   so no cell shows a set which is only partly there, a null source
+   clears the area instead */
+static const byte *upload_src;
+static word upload_dst, upload_left;
+static volatile byte uploading;
+
+static void vdp_upload_wait(void) {
+    while (uploading) { }
+}
+
+static void vdp_upload(word dst, const byte *src, word count) {
+    vdp_upload_wait();
+    if (!vdp_state) {
+	if (src) vdp_memcpy(dst, (byte *) src, count);
+	else vdp_memset(dst, count, 0x00);
+    }
+    else if (count > 0) {
+	upload_dst = dst;
+	upload_src = src;
+	upload_left = count;
+	uploading = TRUE;
+    }
+}
+
+static void vdp_upload_chunk(void) {
+    word size = upload_left > 0x100 ? 0x100 : upload_left;
+    if (upload_src) {
+	vdp_memcpy(upload_dst, (byte *) upload_src, size);
+	upload_src += size;
+    }
+    else {
+	vdp_memset(upload_dst, size, 0x00);
+    }
+    upload_dst += size;
+    upload_left -= size;
+    if (upload_left == 0) uploading = FALSE;
+}
+
+static void sprite_update(void);
 static void vdp_update(void) {
     vblank = 1;
+    sprite_update();
+    if (uploading) {
+	vdp_upload_chunk();
+	return;
+    }
     byte count = 0;
     word *addr = vdp_addr + vdp_tail;
     word *data = vdp_data + vdp_tail;
@@ -426,86 +607,81 @@ static void vdp_memcpy(word addr, byte *ptr, word count) {
     while (count-- > 0) { vram_write(addr++, *ptr++); }
 }
 
+static void vram_next(byte val) {
+    __asm__("out (#0x98), a"); val;
+}
+
+/* the VDP steps its address after every write, only the first sets it */
+static void vdp_stream(word addr, byte *ptr, word count) {
+    if (count == 0) return;
+    vram_write(addr, *ptr++);
+    while (--count > 0) { vram_next(*ptr++); }
+}
+
 static void vdp_enable_display(byte state) {
     vdp_ctrl_reg(1, state ? 0xe0 : 0xa0);
 }
 
-static void vdp_copy_band(word addr, byte *tiles, byte *color, word count) {
-    word t_addr = 0x4000 + addr;
-    word c_addr = 0x6000 + addr;
-    while (count-- > 0) {
-	for (byte i = 0; i < 8; i++) {
-	    vram_write(t_addr++, *tiles++);
-	    vram_write(c_addr++, *color);
+/* colour tables come from pcx-dump as count, colour runs of tile rows */
+static void vdp_copy_band(word addr, byte *tiles, byte *runs, word count) {
+    count = count << 3;
+    vdp_stream(0x4000 + addr, tiles, count);
+    byte left = runs[0] - 1;
+    vram_write(0x6000 + addr, runs[1]);
+    while (--count > 0) {
+	if (left == 0) {
+	    runs += 2;
+	    left = runs[0];
 	}
-	color++;
+	vram_next(runs[1]);
+	left--;
+    }
+}
+
+static byte run_color(const byte *runs, word row) {
+    while (row >= runs[0]) {
+	row -= runs[0];
+	runs += 2;
     }
+    return runs[1];
 }
 
+/* R#3 0x9f and R#4 0x00 mask the table addresses so all three screen
+   thirds use the first 2K of patterns and colours, -DMSX_BANDS keeps
+   a table per third for levels that need tiles of their own in each */
+#ifdef MSX_BANDS
+#define VDP_BANDS	3
+#define VDP_COLOR_REG	0xff
+#define VDP_TILE_REG	0x03
+#else
+#define VDP_BANDS	1
+#define VDP_COLOR_REG	0x9f
+#define VDP_TILE_REG	0x00
+#endif
+
 static void vdp_copy(word addr, byte *tiles, byte *color, word count) {
+    if (retry) return;
     addr = addr << 3;
-    for (byte i = 0; i < 3; i++) {
+    for (byte i = 0; i < VDP_BANDS; i++) {
 	vdp_copy_band(addr, tiles, color, count);
 	addr += 0x800;
     }
 }
 
 static const byte font_color[] = {
-    0x31, 0x31, 0x31, 0x21, 0x21, 0xc1, 0xc1, 0xc1
+    3, 0x31, 2, 0x21, 3, 0xc1
 };
 
-static void vdp_color_band(byte *color, word addr) {
-    for (byte i = 0; i < 8; i++) {
-	vram_write(addr++, color[i]);
-    }
-}
-
-static void vdp_color(byte *color, word addr) {
-    addr = 0x6000 + (addr << 3);
-    for (byte i = 0; i < 3; i++) {
-	vdp_color_band(color, addr);
-	addr += 0x800;
-    }
-}
-
 static void vdp_copy_font(byte should_reduce) {
     reduce = (should_reduce ? 0xa0 : 0x80);
     byte offset = (should_reduce ? 0xc0 : 0xa0);
     byte *tiles = (byte *) WORD(0x4) + 0x100;
-    memset(mirror, 0, 0x300);
+    byte *color = (byte *) mirror;
     byte size = 256 - offset;
-    vdp_copy(offset, tiles, mirror, size);
     for (byte i = 0; i < size; i++) {
-	vdp_color(font_color, offset + i);
+	memcpy(color + i * 6, (byte *) font_color, 6);
     }
-}
-
-static const byte grass_color[] = {
-    0x31, 0x31, 0x31, 0x31, 0x21, 0x21, 0xc1, 0xc1
-};
-
-static const byte sheep_color[] = {
-    0xf1, 0xf1, 0xf1, 0xf1, 0xf1, 0xe1, 0xe1, 0xe1
-};
-
-static void embelish_tiles(void) {
-    for (byte i = 1; i <= 3; i++) {
-	vdp_color(grass_color, i);
-    }
-    for (byte i = 4; i < 16; i++) {
-	vdp_color(sheep_color, i);
-    }
-    for (byte i = 20; i < 32; i++) {
-	vdp_color(sheep_color, i);
-    }
-}
-
-static const byte lava_color[] = {
-    0x91, 0x91, 0x81, 0x61, 0x91, 0x91, 0x81, 0x61
-};
-
-static void embelish_lava(void) {
-    vdp_color(lava_color, 50);
+    vdp_copy(offset, tiles, color, size);
 }
 
 static void msx_write_psg_reg(byte reg, byte val) {
@@ -552,6 +728,136 @@ static byte msx_direction_map(void) {
 }
 #endif
 
+#if defined(SMS) || defined(MSX)
+/* the hunter and its bite are hardware sprites over the name table,
+   the hunter glides two pixels a frame into the cell it moved to */
+#define S_BITE		0
+#define S_HUNTER	1
+#define S_HIDE		0xe0
+
+#ifdef SMS
+#define S_PATTERN	96	/* after the font in the upper tile bank */
+#else
+#define S_PATTERN	0
+#endif
+
+static const byte sprite_cells[] = { 32, 33, 36, 37, 38, 39 };
+
+static byte sprite_x[2], sprite_y[2], sprite_n[2];
+#ifdef MSX
+static byte sprite_c[2];
+static byte sprite_ink[SIZE(sprite_cells)];
+#endif
+static byte hunter_x, hunter_y;
+static volatile byte sprite_dirty;
+
+static byte glide(byte *at, byte to) {
+    int8 diff = to - *at;
+    if (diff == 0) return 0;
+    *at += diff < 0 ? -2 : 2;
+    return 1;
+}
+
+static void sprite_update(void) {
+    byte moved = glide(sprite_x + S_HUNTER, hunter_x);
+    moved |= glide(sprite_y + S_HUNTER, hunter_y);
+    if (!moved && !sprite_dirty) return;
+    sprite_dirty = 0;
+#ifdef SMS
+    vdp_word(0x7f00, sprite_y[0] | (sprite_y[1] << 8));
+    vdp_word(0x7f80, sprite_x[0] | (sprite_n[0] << 8));
+    vdp_word(0x7f82, sprite_x[1] | (sprite_n[1] << 8));
+#endif
+#ifdef MSX
+    for (byte i = 0; i < 2; i++) {
+	vram_write(0x5b00 + (i << 2), sprite_y[i]);
+	vram_next(sprite_x[i]);
+	vram_next(sprite_n[i]);
+	vram_next(sprite_c[i]);
+    }
+#endif
+}
+
+/* SMS sprites are transparent in colour 0 and use the second palette,
+   so the black tile background goes to 0 and 4, 8 to spare entries */
+#ifdef SMS
+static const byte sprite_remap[16] = {
+    0, 1, 2, 3, 1, 5, 6, 7, 2, 9, 10, 11, 0, 13, 14, 15
+};
+#endif
+
+static void sprite_patterns(void) {
+#ifdef SMS
+    byte *pattern = (byte *) mirror;
+    memset(pattern, 0, SIZE(sprite_cells) << 5);
+#endif
+    for (byte k = 0; k < SIZE(sprite_cells); k++) {
+#ifdef SMS
+	const byte *src = tiles + (sprite_cells[k] << 5);
+	for (byte i = 0; i < 32; i += 4) {
+	    for (byte bit = 0x80; bit != 0; bit >>= 1) {
+		byte color = 0;
+		for (byte p = 0; p < 4; p++) {
+		    if (src[i + p] & bit) color |= BIT(p);
+		}
+		color = sprite_remap[color];
+		for (byte p = 0; p < 4; p++) {
+		    if (color & BIT(p)) pattern[i + p] |= bit;
+		}
+	    }
+	}
+	pattern += 32;
+#endif
+#ifdef MSX
+	vdp_stream(0x7800 + (k << 3), (byte *) tiles + (sprite_cells[k] << 3), 8);
+	sprite_ink[k] = run_color(tiles_color, sprite_cells[k] << 3) >> 4;
+#endif
+    }
+#ifdef SMS
+    vdp_upload(0x6000 + (S_PATTERN << 5), (byte *) mirror, SIZE(sprite_cells) << 5);
+    vdp_upload_wait(); /* the scratch is cleared right after */
+#endif
+}
+
+static void sprite_flush(void) {
+    sprite_dirty = 1;
+#ifdef MSX
+    sprite_update();
+#endif
+}
+
+static void place_sprite(byte i, byte cell, word n) {
+    byte x = (n & 0x1f) << 3;
+    byte y = ((n >> 5) << 3) - 1;
+    sprite_n[i] = S_PATTERN + cell - (cell < 36 ? 32 : 34);
+#ifdef MSX
+    sprite_c[i] = sprite_ink[sprite_n[i]];
+#endif
+    if (i == S_HUNTER) {
+	hunter_x = x;
+	hunter_y = y;
+    }
+    else {
+	sprite_x[i] = x;
+	sprite_y[i] = y;
+    }
+    sprite_flush();
+}
+
+static void hide_sprite(byte i) {
+    sprite_y[i] = S_HIDE;
+    if (i == S_HUNTER) hunter_y = S_HIDE;
+    sprite_flush();
+}
+
+/* skip the glide, the hunter is put on a new level */
+static void land_hunter(void) {
+    sprite_x[S_HUNTER] = hunter_x;
+    sprite_y[S_HUNTER] = hunter_y;
+    sprite_flush();
+}
+#endif
+
 #ifdef C64
 static void interrupt(void) __naked {
     __asm__("pha");
@@ -574,6 +880,68 @@ static void copy_font_to_RAM(void) {
     BYTE(0x0001) = 0x35;
 }
 
+#ifdef BANKED
+#define STREAM_NAME	((char *) 0x8900)
+#define STREAM_BANK	BYTE(0x8906)
+#define STREAM_NEXT	BYTE(0x8907)
+
+static byte kernal_load(void) __naked {
+    __asm__("lda #0");
+    __asm__("jsr 0xff90"); /* SETMSG */
+    __asm__("lda #1");
+    __asm__("ldx #8");
+    __asm__("ldy #1");
+    __asm__("jsr 0xffba"); /* SETLFS */
+    __asm__("lda #6");
+    __asm__("ldx #0x00");
+    __asm__("ldy #0x89");
+    __asm__("jsr 0xffbd"); /* SETNAM */
+    __asm__("lda #0");
+    __asm__("jsr 0xffd5"); /* LOAD */
+    __asm__("lda #0");
+    __asm__("rol a");
+    __asm__("rts");
+}
+
+#define LOAD_TRIES	3
+
+static void put_str(const char *msg, word n, byte color);
+static byte c64_key(byte row, byte col);
+
+/* after a few failed loads ask for the disk, the dialog rows show on retry */
+static void load_failed(void) {
+    BYTE(0x0001) = 0x35;
+    put_str("DISK ERROR: SPACE TO RETRY", POS(3, 11), CYAN);
+    while (c64_key((byte) BIT(7), BIT(4)) == 0) { }
+    put_str("                          ", POS(3, 11), CYAN);
+    BYTE(0x0001) = 0x36;
+}
+
+static void stream_bank(byte n) {
+    if (n == 0 || n == STREAM_BANK) return;
+    byte tens = '0', ones = n;
+    while (ones >= 10) {
+	ones -= 10;
+	tens++;
+    }
+    STREAM_NAME[4] = tens;
+    STREAM_NAME[5] = '0' + ones;
+
+    BYTE(0xd01a) = 0x00; /* KERNAL may cli */
+    BYTE(0x0001) = 0x36;
+    byte tries = 0;
+    while (kernal_load()) {
+	if (++tries < LOAD_TRIES) continue;
+	load_failed();
+	tries = 0;
+    }
+    BYTE(0x0001) = 0x35;
+    BYTE(0xd019) = 0xff;
+    BYTE(0xd01a) = 0x01;
+    STREAM_BANK = n;
+}
+#endif
+
 static byte c64_key(byte row, byte col) {
     BYTE(0xdc00) = ~row;
     return ~BYTE(0xdc01) & col;
@@ -622,11 +990,15 @@ static void setup_system(void) {
     vdp_ctrl_reg(0, 0x02);
     vdp_ctrl_reg(1, 0xa0);
     vdp_ctrl_reg(2, 0x06);
-    vdp_ctrl_reg(3, 0xff);
+    vdp_ctrl_reg(3, VDP_COLOR_REG);
+    vdp_ctrl_reg(4, VDP_TILE_REG);
+    vdp_ctrl_reg(5, 0x36);
+    vdp_ctrl_reg(6, 0x07);
     vdp_ctrl_reg(7, 0x01);
     vdp_ctrl_reg(8, 0x02);
     vdp_memset(0x4000, 0x00, 8);
     vdp_memset(0x6000, 0x11, 8);
+    vdp_memset(0x5b00, 0xd0, 0x80);
     msx_write_psg_reg( 7, 0xbc);
     msx_write_psg_reg(11, 0xff);
     msx_write_psg_reg(12, 0xff);
@@ -648,6 +1020,10 @@ static void setup_system(void) {
     BYTE(0xd01a) = 0x01; /* genereate raster irq */
     BYTE(0xd012) = 0x00; /* generate on line 0 */
     WORD(0xfffe) = (word) &interrupt;
+#ifdef BANKED
+    memcpy(STREAM_NAME, "BANK", 4);
+    STREAM_BANK = STREAM_NEXT = 0;
+#endif
     memset((byte *) 0x8c00, 0x00, 1000);
     memset((byte *) 0xa000, 0x00, 8192);
     BYTE(0xd011) = 0x3b;
@@ -668,20 +1044,23 @@ static void setup_system(void) {
 }
 
 static void clear_screen(void) {
+    if (retry) return;
 #ifdef ZXS
     memset((byte *) 0x5800, 0x00, 0x300);
     memset((byte *) 0x4000, 0x00, 0x1800);
     out_fe(0);
 #endif
 #ifdef SMS
-    vdp_enable_display(FALSE);
-    vdp_memset(0x7800, 0x600, 0x00);
-    vdp_head = vdp_tail = 0;
-    vdp_enable_display(TRUE);
+    vdp_upload(0x7800, 0, 0x600);
+    vdp_head = vdp_tail; /* cells queued before the clear are stale */
 #endif
 #ifdef MSX
     vdp_memset(0x5800, 0, 0x0300);
 #endif
+#if defined(SMS) || defined(MSX)
+    hide_sprite(S_BITE);
+    hide_sprite(S_HUNTER);
+#endif
 #ifdef C64
     memset((byte *) 0x8c00, 0x00, 1000);
 #endif
@@ -704,6 +1083,7 @@ static void precalculate(void) {
 }
 
 static void put_char(char symbol, word n, byte color) {
+    if (hidden(n)) return;
 #if defined(ZXS) || defined(C64)
     byte x = n & 0x1f;
     byte y = (n >> 2) & ~7;
@@ -787,6 +1167,7 @@ static word sub10(word a, word b) __naked{
 #endif
 
 static void put_tile(byte cell, word n) {
+    if (hidden(n)) return;
 #if defined(ZXS) || defined(C64)
     byte x = n & 0x1f;
     byte y = (n >> 2) & ~7;
@@ -824,13 +1205,56 @@ extern byte **queue;
 static byte **queue;
 #endif
 
-#define QUEUE(x) *(queue++) = (x)
+/*
+ * rewind journal, a ring of 3 byte entries: flags | offset high, offset
+ * low and the old cell; marks keep hunter position and what it stood on,
+ * meat entries the score before a bite, low byte first
+ */
+#define J_QUEUE		BIT(7)
+#define J_HUNT		BIT(6)
+#define J_MARK		BIT(5)
+#define J_MEAT		BIT(4)
+#define J_BYTES		(3 * 512)
+
+#ifdef C64
+#define JOURNAL		((byte *) 0x8300)
+#else
+static byte journal[J_BYTES];
+#define JOURNAL		journal
+#endif
+
+static byte recording;
+static byte j_flags;
+static word j_head, j_used, j_marks;
+
+static void journal_entry(byte flags, word n, byte old) {
+    byte *entry = JOURNAL + j_head;
+    if (j_used == J_BYTES) {
+	if (entry[0] & J_MARK) j_marks--;
+    }
+    else {
+	j_used += 3;
+    }
+    entry[0] = flags | (n >> 8);
+    entry[1] = n & 0xff;
+    entry[2] = old;
+    j_head += 3;
+    if (j_head == J_BYTES) j_head = 0;
+}
+
+static void record(byte *ptr, byte flags) {
+    if (recording) {
+	journal_entry(flags | j_flags, ptr - forest, *ptr & ~C_DONE);
+    }
+}
+
+#define QUEUE(x) (record((x), J_QUEUE), *(queue++) = (x))
 static inline void regrow_neighbors(byte *ptr) {
     for (byte n = 0; n < SIZE(neighbors); n++) {
 	byte *near = ptr + neighbors[n];
 	if (*near == 0) {
-	    *near = 1;
 	    QUEUE(near);
+	    *near = 1;
 	}
     }
 }
@@ -889,22 +1313,65 @@ static void update_cell(byte *ptr) {
     }
 }
 
+static byte key_state(void);
+
+static byte frames;
+static byte keys;
+static byte latch;
+
+/* update_cell calls per frame, CELL_CYCLES a call is an estimate and a
+   quarter of the frame is left for the interrupt, drawing and keys */
+#define FRAME_CELLS	((byte) (FRAME_CYCLES * 3 / 4 / CELL_CYCLES))
+
+static byte **cursor;
+static byte spent;
+
+/* called once per frame, latches key presses so none are lost mid epoch */
+static void poll_keys(void) {
+    byte next = key_state();
+    latch |= next & (keys ^ next);
+    keys = next;
+}
+
+static void next_frame(void) {
+    vblank = 0;
+    frames++;
+    spent = 0;
+#ifdef MSX
+    sprite_update();
+#endif
+    poll_keys();
+}
+
 static void clean_tags(byte **ptr) {
     while (*ptr) *(*ptr++) &= ~C_DONE;
 }
 
-static void advance_cells(byte **ptr) {
-    while (*ptr) {
-	byte *place = *ptr++;
+/* advance the queue from the cursor until it ends, TRUE, or until the
+   frame budget is spent, FALSE, the next call resumes where it stopped */
+static byte advance_slice(void) {
+    while (*cursor) {
+	if (spent >= FRAME_CELLS) return FALSE;
+	byte *place = *cursor++;
 	if ((*place & (C_TILE | C_DONE | C_PLAY)) == 0) {
 	    update_cell(place);
 	    *place |= C_DONE;
+	    spent++;
 	}
     }
+    return TRUE;
+}
+
+static void advance_cells(void) {
+    while (!advance_slice()) {
+	while (!vblank) { }
+	next_frame();
+    }
 }
 
 static void advance_forest(byte **ptr) {
-    advance_cells(ptr);
+    cursor = ptr;
+    advance_cells();
     clean_tags(ptr);
 }
 
@@ -976,11 +1443,19 @@ static void rolling_rock_sound(void) {
 
 static word meat;
 static void bite(word dst) {
+    if (recording) journal_entry(J_MEAT, meat & 0xff, meat >> 8);
     meat = add10(meat, 5);
     for (byte i = 0; i < 4; i++) {
+#if defined(SMS) || defined(MSX)
+	place_sprite(S_BITE, 36 + i, dst);
+#else
 	put_tile(36 + i, dst);
+#endif
 	bite_sound(i);
     }
+#if defined(SMS) || defined(MSX)
+    hide_sprite(S_BITE);
+#endif
 }
 
 static byte rock_type(byte pos) {
@@ -990,10 +1465,12 @@ static byte rock_type(byte pos) {
 static byte roll_rock(int8 diff) {
     word dst = pos + (diff << 1);
     if ((forest[dst] & (C_TILE | C_SIZE)) == 0) {
+	record(forest + dst, 0);
 	forest[dst] = T_ROCK;
 	goto success;
     }
     if (forest[dst] == T_SAND) {
+	record(forest + dst, 0);
 	forest[dst] = T_ROLL;
 	goto success;
     }
@@ -1018,11 +1495,25 @@ static byte is_grazer(word dst) {
 static void put_sprite(byte cell, byte base, word n);
 
 static void put_sand(word n) {
+    record(forest + n, 0);
     forest[n] = T_SAND;
     put_sprite(6, 0, n);
 }
 
 static byte standing;
+static void draw_hunter(byte cell, word n, byte ground) {
+#if defined(SMS) || defined(MSX)
+    if (ground) {
+	if (standing < C_TILE || standing == T_ROCK) put_tile(C_BARE, n);
+	else put_sprite(6, 0, n);
+    }
+    place_sprite(S_HUNTER, cell, n);
+#else
+    put_tile(cell, n);
+    ground;
+#endif
+}
+
 static void leave_tile(byte *place) {
     if (standing < C_TILE || standing == T_ROCK) {
 	*place = C_BARE;
@@ -1035,19 +1526,22 @@ static void leave_tile(byte *place) {
 
 static void move_hunter(int8 diff) {
     word dst = pos + diff;
+    j_flags = J_HUNT;
     if (dst < SIZE(forest) && can_move_into(forest[dst], diff)) {
 	byte *place = forest + pos;
 	byte cell = *place;
-	leave_tile(place);
 	QUEUE(place);
+	leave_tile(place);
 
 	standing = forest[dst];
 	if (is_grazer(dst)) bite(dst);
 	byte face = get_face(diff, cell);
+	record(forest + dst, 0);
 	forest[dst] = C_PLAY | face;
-	put_tile(face ? 33 : 32, dst);
+	draw_hunter(face ? 33 : 32, dst, standing != C_BARE && standing != T_SAND);
 	pos = dst;
     }
+    j_flags = 0;
 }
 
 static void put_hunter(word where) {
@@ -1055,16 +1549,20 @@ static void put_hunter(word where) {
     forest[pos] = 0;
     standing = C_BARE;
     move_hunter(0);
+#if defined(SMS) || defined(MSX)
+    land_hunter();
+#endif
 }
 
 static void put_item(word where, byte type, byte sprite) {
+    record(forest + where, 0);
     forest[where] = type;
     put_tile(sprite, where);
 }
 
 static void queue_item(word where, byte type, byte sprite) {
-    put_item(where, type, sprite);
     QUEUE(forest + where);
+    put_item(where, type, sprite);
 }
 
 static byte fast_forward(void) {
@@ -1111,6 +1609,8 @@ static byte space_or_enter(void) {
 }
 
 static byte wait_space_or_enter(void) {
+    FETCH();
+    if (retry) return FALSE;
     byte prev, next = space_or_enter();
     do {
 	prev = next;
@@ -1175,41 +1675,252 @@ static byte key_state(void) {
     return skip_epoch() | movement_keys();
 }
 
-static void wait_user_input(void) {
-    byte change, prev, next = key_state();
+static void redraw_cell(word n) {
+    byte cell = forest[n];
+    switch (cell) {
+    case T_SAND:
+	put_sprite(6, 0, n);
+	break;
+    case T_LAVA:
+	put_sprite(10, 0, n);
+	break;
+    case T_ROCK:
+    case T_ROLL:
+	put_tile(rock_type(n), n);
+	break;
+    default:
+	if (cell & C_PLAY) {
+	    draw_hunter(cell & C_FACE ? 33 : 32, n, TRUE);
+	}
+	else {
+	    tile_ptr(forest + n);
+	}
+	break;
+    }
+}
+
+#ifdef C64
+#define SHADOW		((byte *) 0x8000)
+#else
+static byte shadow[SIZE(forest)];
+#define SHADOW		shadow
+#endif
+
+static byte ahead;
+static byte **ahead_from;
+static byte **ahead_queue;
+static byte **ahead_list;
+static word ahead_head;
+
+/* drop journal entries of a speculation that did not stand */
+static void journal_truncate(void) {
+    if (j_marks == 0) {
+	j_head = j_used = 0;
+	return;
+    }
+    word size = j_head - ahead_head;
+    if (j_head < ahead_head) size += J_BYTES;
+    j_used -= size;
+    j_head = ahead_head;
+}
+
+/* compute the next epoch while the player thinks, a slice a frame */
+static void speculate(byte **src, byte **dst) {
+    byte **end = queue;
+    memcpy(SHADOW, forest, SIZE(forest));
+    ahead_head = j_head;
+    *end = 0;
+    queue = dst;
+    cursor = src;
+    ahead_list = src;
+    ahead_from = end;
+    ahead = TRUE;
+}
+
+/* the rest of the speculation runs before the hunter may queue cells */
+static void speculation_done(void) {
+    if (!ahead_list) return;
+    advance_cells();
+    clean_tags(ahead_list);
+    ahead_list = 0;
+    ahead_queue = queue;
+    queue = ahead_from;
+}
+
+/* a speculation, done or not, is undone through the shadow copy */
+static void drop_speculation(void) {
+    memcpy(forest, SHADOW, SIZE(forest));
+    journal_truncate();
+    ahead_list = 0;
+    queue = ahead_from;
+    ahead = FALSE;
+}
+
+/* did the epoch touch cells next to pos, pos + diff or pos + 2 * diff */
+static byte interferes(byte **ptr, int8 diff) {
+    while (*ptr) {
+	word n = (*ptr++ - forest) - pos;
+	for (byte i = 0; i < 3; i++) {
+	    if (n == 0 || n == 1 || n == (word) -1) return TRUE;
+	    if (n == 32 || n == (word) -32) return TRUE;
+	    n -= diff;
+	}
+    }
+    return FALSE;
+}
+
+static byte rewind_key(void) {
+#ifdef ZXS
+    return ~in_key(0xfb) & 8;
+#endif
+
+#ifdef SMS
+    byte pressed = paused; /* the buttons skip and fast forward */
+    paused = 0;
+    return pressed;
+#endif
+
+#ifdef MSX
+    return ~in_key(4) & BIT(7);
+#endif
+
+#ifdef C64
+    return c64_key(BIT(2), BIT(1));
+#endif
+}
+
+static void journal_mark(void) {
+    if (recording) {
+	journal_entry(J_MARK, pos, standing);
+	j_marks++;
+    }
+}
+
+static byte *journal_back(byte *entry) {
+    if (entry == JOURNAL) entry += J_BYTES;
+    return entry - 3;
+}
+
+static word entry_pos(byte *entry) {
+    return ((entry[0] & 3) << 8) | entry[1];
+}
+
+/* undo the journal to the previous wait and rebuild its queue list */
+static void rewind_epoch(byte **list) {
+    byte *entry = JOURNAL + j_head;
+    byte marks = 0;
+    for (;;) {
+	entry = journal_back(entry);
+	j_used -= 3;
+	if (entry[0] & J_MARK) {
+	    if (++marks == 2) break;
+	    j_marks--;
+	    continue;
+	}
+	if (entry[0] & J_MEAT) {
+	    meat = (entry[2] << 8) | entry[1];
+	    continue;
+	}
+	word n = entry_pos(entry);
+	forest[n] = entry[2];
+	redraw_cell(n);
+    }
+    j_used += 3;
+    j_head = entry + 3 - JOURNAL;
+    if (j_head == J_BYTES) j_head = 0;
+    pos = entry_pos(entry);
+    standing = entry[2];
+#if defined(SMS) || defined(MSX)
+    draw_hunter(forest[pos] & C_FACE ? 33 : 32, pos, TRUE);
+#endif
+
+    byte *last = entry;
     do {
-	prev = next;
-	next = key_state();
-	change = next & (prev ^ next);
-	if (fast_forward()) return;
-    } while (change == 0);
+	entry = journal_back(entry);
+    } while ((entry[0] & J_MARK) == 0);
+    queue = list;
+    while (entry != last) {
+	entry += 3;
+	if (entry == JOURNAL + J_BYTES) entry = JOURNAL;
+	if ((entry[0] & (J_QUEUE | J_HUNT)) == J_QUEUE) {
+	    *(queue++) = forest + entry_pos(entry);
+	}
+    }
+
+    epoch = sub10(epoch, 1);
+    steps--;
+    put_num(sub10(epoch, 1), POS(7, 23), CYAN);
+}
+
+/* fast forward runs an epoch every EPOCH_FRAMES at most */
+static void fast_epoch(void) {
+    while (frames < EPOCH_FRAMES) {
+	if (vblank) next_frame();
+    }
+    latch = 0;
+}
+
+static void wait_user_input(byte **src, byte **dst) {
+    journal_mark();
+    if (fast_forward()) {
+	fast_epoch();
+	return;
+    }
+  restart:
+    speculate(src, dst);
+    do {
+	if (rewind_key() && j_marks >= 3) {
+	    drop_speculation();
+	    rewind_epoch(src);
+	    while (rewind_key()) { }
+	    latch = 0;
+	    goto restart;
+	}
+	poll_keys();
+	if (fast_forward()) {
+	    speculation_done();
+	    fast_epoch();
+	    return;
+	}
+	if (ahead_list && advance_slice()) {
+	    speculation_done();
+	}
+	if (vblank) next_frame();
+    } while (latch == 0);
+
+    byte change = latch;
+    latch = 0;
 
     for (byte n = 0; n < SIZE(neighbors); n++) {
 	if (change & BIT(n)) {
+	    if (interferes(src, neighbors[n])) {
+		drop_speculation();
+	    }
+	    speculation_done();
 	    move_hunter(neighbors[n]);
 	    break;
 	}
     }
+    speculation_done();
 }
 
 static void display_forest(byte **ptr) {
     while (*ptr) {
 	tile_ptr(*ptr);
 	ptr++;
+	if (vblank) next_frame();
     }
 }
 
-static byte flip_bits(byte source) {
-    byte result = 0;
-    for (byte i = 0; i < 8; i++) {
-	result = result << 1;
-	result |= source & 1;
-	source = source >> 1;
-    }
-    return result;
-}
-
 #if defined(ZXS) || defined(C64)
+#define R2(n)	n, n + 2 * 64, n + 1 * 64, n + 3 * 64
+#define R4(n)	R2(n), R2(n + 2 * 16), R2(n + 1 * 16), R2(n + 3 * 16)
+#define R6(n)	R4(n), R4(n + 2 * 4), R4(n + 1 * 4), R4(n + 3 * 4)
+
+static const byte flip_bits[256] = {
+    R6(0), R6(2), R6(1), R6(3)
+};
+
 static const byte *sprite;
 static const byte *sprite_color;
 #define TILE_ATTRIBURE(x)
@@ -1221,7 +1932,7 @@ static const byte *sprite_color;
 static byte sprite_offset;
 #define TILE_ATTRIBURE(x)
 #define TILESET(tiles, offset) \
-    vdp_copy(offset, tiles, tiles##_color, SIZE(tiles##_color)); \
+    vdp_copy(offset, tiles, tiles##_color, SIZE(tiles) >> 3); \
     sprite_offset = offset;
 
 #elif defined(SMS)
@@ -1229,13 +1940,12 @@ static word sprite_offset;
 #define TILE_ATTRIBURE(x) \
     sprite_offset |= (x);
 #define TILESET(tiles, offset) \
-    vdp_enable_display(FALSE); \
-    vdp_memcpy(0x4000 + (offset << 5), tiles, SIZE(tiles)); \
-    vdp_enable_display(TRUE); \
+    if (!retry) vdp_upload(0x4000 + (offset << 5), tiles, SIZE(tiles)); \
     sprite_offset = offset;
 #endif
 
 static void put_sprite(byte cell, byte base, word n) {
+    if (hidden(n)) return;
     byte index = base + (cell & 0x1f);
 
 #if defined(ZXS) || defined(C64)
@@ -1245,14 +1955,25 @@ static void put_sprite(byte cell, byte base, word n) {
     byte flipV = cell & 0x40;
     COLOR(x, y, n) = sprite_color[index];
     const byte *addr = sprite + (index << 3);
-    if (flipV) addr = addr + 7;
+    int8 step = 1;
+    if (flipV) {
+	addr = addr + 7;
+	step = -1;
+    }
     byte *ptr = map_y[y] + SPRITE_X(x);
-    for (byte i = 0; i < 8; i++) {
-	byte data = *addr;
-	if (flipV) addr--; else addr++;
-	if (flipH) data = flip_bits(data);
-	*ptr = data;
-	ptr += SPRITE_INC;
+    if (flipH) {
+	for (byte i = 0; i < 8; i++) {
+	    *ptr = flip_bits[*addr];
+	    addr += step;
+	    ptr += SPRITE_INC;
+	}
+    }
+    else {
+	for (byte i = 0; i < 8; i++) {
+	    *ptr = *addr;
+	    addr += step;
+	    ptr += SPRITE_INC;
+	}
     }
 #endif
 
@@ -1331,13 +2052,7 @@ static void raw_image(byte *level, byte game, word size, word n) {
 }
 
 static void display_image(byte *level, byte game, word size, word n) {
-#ifdef SMS
-    vdp_enable_display(FALSE);
-#endif
     raw_image(level, game, size, n);
-#ifdef SMS
-    vdp_enable_display(TRUE);
-#endif
 }
 
 static void increment_epoch(void) {
@@ -1349,15 +2064,23 @@ static void increment_epoch(void) {
 static int8 (*finish)(void);
 
 static int8 game_round(byte **src, byte **dst) {
-    queue = dst;
-    advance_forest(src);
+    frames = 0;
+    if (ahead) {
+	queue = ahead_queue;
+	advance_forest(ahead_from);
+	ahead = FALSE;
+    }
+    else {
+	queue = dst;
+	advance_forest(src);
+    }
     display_forest(dst);
     int8 ret = finish();
     increment_epoch();
     if (ret == 0) {
-	wait_user_input();
+	wait_user_input(dst, src);
     }
-    QUEUE(0);
+    *(queue++) = 0;
     return ret;
 }
 
@@ -1370,8 +2093,8 @@ static void reset_memory(void) {
     TILESET(font, 0x100);
 #endif
 
-#ifdef MSX
-    embelish_tiles();
+#if defined(SMS) || defined(MSX)
+    sprite_patterns();
 #endif
 
     memset(update, 0x00, sizeof(update));
@@ -1450,8 +2173,23 @@ static int8 ending_escape(void) {
     return 0;
 }
 
+#define WHEEL		8
+#define E_WAVE		0
+#define E_FOAM		1
+#define E_TIDE		2
+
+/* hazard events due within the next WHEEL epochs, a bit per event */
+static byte wheel[WHEEL];
+
+static void schedule(byte event, byte delay) {
+    wheel[(steps + delay) & (WHEEL - 1)] |= BIT(event);
+}
+
 static void put_wave(word n, byte tile, byte color) {
     forest[n] = T_WAVE;
+#if defined(SMS) || defined(MSX)
+    if (n == pos) hide_sprite(S_HUNTER);
+#endif
 
 #ifdef ZXS
     put_sprite(tile, 0, n);
@@ -1459,7 +2197,7 @@ static void put_wave(word n, byte tile, byte color) {
 #endif
 
 #ifdef SMS
-    word id = 40 + tile;
+    word id = fence_slot + tile;
     if (color) id |= 0x800;
     vdp_put_tile(n, id);
 #endif
@@ -1467,7 +2205,7 @@ static void put_wave(word n, byte tile, byte color) {
 #ifdef MSX
     word addr = n + 0x5800;
     if (color) tile += 18;
-    vram_write(addr, 40 + tile);
+    vram_write(addr, fence_slot + tile);
 #endif
 
 #ifdef C64
@@ -1511,25 +2249,47 @@ static void recede_wave(int8 len) {
 }
 
 static int8 wave_len, wave_dir;
-static int8 ending_tsunami(void) {
-    if (epoch & 1) {
-	if (wave_dir < 0) {
-	    draw_wave(wave_len, 1);
-	}
-	else {
-	    recede_wave(wave_len);
-	}
-	if (wave_len == -24 && wave_dir == -1) {
-	    put_sand(POS(30, 7));
-	    wave_dir = 1;
-	}
-	else {
-	    wave_len += wave_dir;
-	}
+static void wave_event(void) {
+    if (wave_dir < 0) {
+	draw_wave(wave_len, 1);
+    }
+    else {
+	recede_wave(wave_len);
+    }
+    if (wave_len == -24 && wave_dir == -1) {
+	put_sand(POS(30, 7));
+	wave_dir = 1;
     }
-    else if (wave_dir < 0) {
+    else {
+	wave_len += wave_dir;
+    }
+    schedule(E_WAVE, 2);
+}
+
+static void foam_event(void) {
+    if (wave_dir < 0) {
 	draw_wave(wave_len + 2, 0);
+	schedule(E_FOAM, 2);
+    }
+}
+
+static void tide_event(void);
+
+static void (* const events[])(void) = {
+    &wave_event, &foam_event, &tide_event,
+};
+
+static void run_events(void) {
+    byte slot = steps & (WHEEL - 1);
+    byte due = wheel[slot];
+    wheel[slot] = 0;
+    for (byte i = 0; due != 0; i++, due >>= 1) {
+	if (due & 1) events[i]();
     }
+}
+
+static int8 ending_tsunami(void) {
+    run_events();
     if (forest[pos] == T_WAVE || no_grazers()) {
 	return -1;
     }
@@ -1557,6 +2317,8 @@ static int8 ending_equilibrium(void) {
 }
 
 static int8 tide_pos[24];
+static byte tide_live[24];
+static byte tide_count;
 static const int8 tide_max[24] = {
     9, 22, 10, 21, 10, 21, 11, 20, 11, 20, 12, 19,
     12, 19, 12, 19, 12, 19, 11, 20, 11, 20, 10, 21,
@@ -1586,30 +2348,60 @@ static int8 recede_put(int8 *ptr, int8 y, int8 dir) {
     return 0;
 }
 
-static void tidal_movement(void) {
-  restart_tide:
-    byte advance = 0;
-    int8 *ptr = tide_pos;
-    for (int8 y = 7; y < 19; y++) {
+/* walls and waves stay put until the tide turns */
+static byte tide_stuck(int8 *ptr, int8 y, int8 dir) {
+    byte cell = forest[(y << 5) + *ptr + dir];
+    return cell == T_WALL || cell == T_WAVE;
+}
+
+static void tide_refill(void) {
+    for (byte i = 0; i < SIZE(tide_live); i++) {
+	tide_live[i] = i;
+    }
+    tide_count = SIZE(tide_live);
+}
+
+/* move the fronts which may still move, drop those which never will */
+static byte tide_pass(void) {
+    byte advance = 0, live = 0;
+    for (byte i = 0; i < tide_count; i++) {
+	byte k = tide_live[i];
+	int8 *ptr = tide_pos + k;
+	int8 y = 7 + (k >> 1);
+	int8 dir = (k & 1) ? -1 : 1;
+	byte moved;
 	if (wave_dir == 0) {
-	    advance += tidal_put(ptr++, y, 1);
-	    advance += tidal_put(ptr++, y, -1);
+	    moved = tidal_put(ptr, y, dir);
+	    if (moved || !tide_stuck(ptr, y, dir)) tide_live[live++] = k;
 	}
-	else if (wave_dir == 1) {
-	    advance += recede_put(ptr++, y, -1);
-	    advance += recede_put(ptr++, y, 1);
+	else {
+	    moved = recede_put(ptr, y, -dir);
+	    if (moved) tide_live[live++] = k;
 	}
+	advance += moved;
+    }
+    tide_count = live;
+    return advance;
+}
+
+static void tide_event(void) {
+    byte delay = 1;
+    byte advance = tide_pass();
+    if (advance == 0 && wave_dir == 0) {
+	wave_dir = 1;
+	tide_refill();
+	advance = tide_pass();
     }
     if (advance == 0) {
-	wave_dir = (wave_dir + 1) & 3;
-	if (wave_dir == 1) {
-	    goto restart_tide;
-	}
+	wave_dir = 0; /* slack water for two epochs */
+	tide_refill();
+	delay = 3;
     }
+    schedule(E_TIDE, delay);
 }
 
 static int8 ending_migration(void) {
-    tidal_movement();
+    run_events();
 
     byte cell = forest[POS(8, 22)];
     if (cell & C_SIZE) {
@@ -1732,9 +2524,9 @@ static int8 ending_lonesome(void) {
 }
 
 static void put_lava(word n) {
+    QUEUE(forest + n);
     put_sprite(10, 0, n);
     forest[n] = T_LAVA;
-    QUEUE(forest + n);
 }
 
 static void lava_flow(byte *ptr) {
@@ -1746,6 +2538,15 @@ static void lava_flow(byte *ptr) {
     }
 }
 
+/* lava walled in by lava and walls can never flow again */
+static byte lava_edge(byte *ptr) {
+    for (byte i = 0; i < SIZE(neighbors); i++) {
+	byte near = *(ptr + neighbors[i]);
+	if (near != T_LAVA && near != T_WALL) return TRUE;
+    }
+    return FALSE;
+}
+
 static void advance_lava(void) {
     byte count = steps & 7;
     byte **ptr = queue < mirror ? mirror : update;
@@ -1755,7 +2556,7 @@ static void advance_lava(void) {
 	    if (count == 0) {
 		lava_flow(place);
 	    }
-	    else {
+	    else if (count > 1 || lava_edge(place)) {
 		QUEUE(place);
 	    }
 	}
@@ -1812,6 +2613,7 @@ static void adat_meitas(void);
 
 static void finish_game(void) {
     clear_screen();
+    MAP_BANK(BANK(sunset_map));
 
     TILESET(sunset, 0);
     TILE_ATTRIBURE(0x800);
@@ -1824,7 +2626,7 @@ static void finish_game(void) {
 }
 
 static void use_fence_sprites(void) {
-    TILESET(fence, 40);
+    TILESET(fence, fence_slot);
 }
 
 static void fenced_level(byte *level, word size) {
@@ -1833,6 +2635,16 @@ static void fenced_level(byte *level, word size) {
     display_image(level, 1, size, 0);
 }
 
+static void generated_level(const struct Terrain *t) {
+    clear_screen();
+    use_fence_sprites();
+    terrain(forest, t);
+    in_game = TRUE;
+    for (word n = 0; n < SIZE(forest); n++) {
+	display_cell(forest[n], 0, n);
+    }
+}
+
 static void quarantine_level(void) {
     put_str("- QUARANTINE -", POS(9, 4), L_GREEN);
     put_str("Prevent GRAZER population", POS(3, 16), D_GREEN);
@@ -1855,6 +2667,7 @@ static void earthquake_level(void) {
     finish = &ending_escape;
 }
 
+static const struct Terrain gardener = { 0x0002, 14, 4, 6, 2 };
 static void gardener_level(void) {
     put_str("- PREDATOR -", POS(10, 4), L_GREEN);
     put_str("Hunt down invasive GRAZER", POS(4, 16), D_GREEN);
@@ -1862,7 +2675,7 @@ static void gardener_level(void) {
     put_str("can fully recover and regrow", POS(2, 18), D_GREEN);
     wait_space_or_enter();
 
-    fenced_level(gardener_map, SIZE(gardener_map));
+    generated_level(&gardener);
 
     finish = &ending_vegetation;
 }
@@ -1884,6 +2697,8 @@ static void tsunami_level(void) {
     tsunami_rnd = 11;
     wave_len = 24;
     wave_dir = -1;
+    schedule(E_FOAM, 0);
+    schedule(E_WAVE, 1);
 
     put_str("- TSUNAMI -", POS(10, 4), L_GREEN);
     put_str("Help GRAZERs survive TSUNAMI", POS(2, 16), D_GREEN);
@@ -1915,8 +2730,10 @@ static void equilibrium_level(void) {
 }
 
 static void migration_level(void) {
-    wave_dir = 3;
+    wave_dir = 0;
     memcpy(tide_pos, tide_max, sizeof(tide_max));
+    tide_refill();
+    schedule(E_TIDE, 1);
 
     put_str("- MIGRATION -", POS(9, 4), L_GREEN);
     put_str("Help GRAZERs migrate south", POS(3, 16), D_GREEN);
@@ -1971,11 +2788,9 @@ static void eruption_level(void) {
 
     fenced_level(eruption_map, SIZE(eruption_map));
 
+    TILESET(volcano, volcano_slot);
 #ifdef MSX
-    TILESET(volcano, 108);
     vdp_copy_font(1);
-#else
-    TILESET(volcano, 72);
 #endif
 
     TILE_ATTRIBURE(0x800);
@@ -1985,7 +2800,6 @@ static void eruption_level(void) {
     put_lava(POS(15, 6));
 
 #ifdef MSX
-    embelish_lava();
     vdp_enable_display(TRUE);
 #endif
 
@@ -2022,19 +2836,19 @@ static void erosion_level(void) {
 }
 
 static const struct Level all_levels[] = {
-    { &gardener_level },
-    { &quarantine_level },
-    { &earthquake_level },
-    { &tsunami_level },
-    { &flooding_level },
-    { &equilibrium_level },
-    { &migration_level },
-    { &aridness_level },
-    { &lonesome_level },
-    { &eruption_level },
-    { &fertility_level },
-    { &erosion_level },
-    { &finish_game },
+    { &gardener_level, 0, TRUE },
+    { &quarantine_level, BANK(quarantine_map), TRUE },
+    { &earthquake_level, BANK(earthquake_map), TRUE },
+    { &tsunami_level, BANK(tsunami_map), FALSE },
+    { &flooding_level, BANK(flooding_map), TRUE },
+    { &equilibrium_level, BANK(equilibrium_map), FALSE },
+    { &migration_level, BANK(migration_map), FALSE },
+    { &aridness_level, BANK(aridness_map), TRUE },
+    { &lonesome_level, BANK(lonesome_map), FALSE },
+    { &eruption_level, BANK(eruption_map), TRUE },
+    { &fertility_level, BANK(fertility_map), TRUE },
+    { &erosion_level, BANK(erosion_map), FALSE },
+    { &finish_game, BANK(sunset_map), FALSE },
 };
 
 static void load_level(byte n) {
@@ -2042,15 +2856,43 @@ static void load_level(byte n) {
 #ifdef MSX
     vdp_copy_font(0);
 #endif
+    memset(wheel, 0, sizeof(wheel));
+    PREFETCH(all_levels[n].bank);
     all_levels[n].fn();
 }
 
+/* the walls are as they were, bring back cells that changed in play */
+static void restore_screen(void) {
+    for (word n = 0; n < SIZE(forest); n++) {
+	byte cell = forest[n];
+	if (cell == T_WALL) continue;
+	if (cell != SHADOW[n] || (DIALOG <= n && n < DIALOG_END)) {
+	    redraw_cell(n);
+	}
+    }
+}
+
+static byte failed;
 static void init_variables(void) {
     epoch = 0;
     steps = 0;
     queue = update;
+    if (failed) {
+	memcpy(SHADOW, forest, SIZE(forest));
+	retry = TRUE;
+    }
+    recording = FALSE;
     load_level(level);
+    if (retry) {
+	retry = FALSE;
+	restore_screen();
+    }
+    j_head = j_used = j_marks = 0;
+    recording = all_levels[level].rewind;
+    journal_mark();
     put_str("EPOCH:0000", POS(1, 23), CYAN);
+    keys = key_state();
+    latch = 0;
 }
 
 const word wah_wah[] = { // D4 -> C4# -> C4 -> B3
@@ -2222,7 +3064,10 @@ static void adat_meitas(void) {
 }
 
 static void display_msg(const char *text_message) {
-    raw_image(dialog_map, 0, SIZE(dialog_map), 0x140);
+#if defined(SMS) || defined(MSX)
+    if (DIALOG <= pos && pos < DIALOG_END) hide_sprite(S_HUNTER);
+#endif
+    raw_image(dialog_map, 0, SIZE(dialog_map), DIALOG);
     put_str(text_message, POS(12, 11), CYAN);
 }
 
@@ -2241,9 +3086,13 @@ static void game_loop(void) {
     case  1:
 	display_msg("  DONE  ");
 	success_tune();
+	failed = 0;
 	level++;
+	/* the next level loads while DONE is shown */
+	if (level < SIZE(all_levels)) PREFETCH(all_levels[level].bank);
 	break;
     case -1:
+	failed = 1;
 	display_msg(" FAILED ");
 	sad_trombone_wah_wah_wah();
 	break;
@@ -2323,12 +3172,11 @@ static void wait_start(void) {
 
 static void title_screen(void) {
     clear_screen();
+    MAP_BANK(BANK(logo_map));
+    TILESET(logo, logo_slot);
 #if defined(ZXS) || defined(C64)
-    TILESET(logo, 72);
     sprite_color = mirror;
     memset(mirror, 0, sizeof(logo) / 8);
-#else
-    TILESET(logo, 40);
 #endif
     display_image(logo_map, 0, SIZE(logo_map), 0x100);
 
@@ -11,38 +11,80 @@ const char *file = "grazers.bin";
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
-int main(int argc, char **argv) {
+static int file_size(const char *name) {
     struct stat st;
-    if (stat(file, &st) != 0) {
-	printf("ERROR \"%s\" not found\n", file);
-	exit(-ENOENT);
-    }
-    if (st.st_size > 0x7ff0) {
-	printf("ERROR \"%s\" too large\n", file);
+    if (stat(name, &st) != 0) {
+	printf("ERROR \"%s\" not found\n", name);
 	exit(-ENOENT);
     }
-    unsigned char *buf = malloc(0x8000);
-    memset(buf, 0, sizeof(buf));
+    return st.st_size;
+}
 
-    int in = open(file, O_RDONLY);
-    read(in, buf, st.st_size);
+static void load(const char *name, unsigned char *buf, int size) {
+    int in = open(name, O_RDONLY);
+    read(in, buf, size);
     close(in);
+}
 
+static int rom_size(int size) {
+    int total = 0x8000;
+    while (total < size) total <<= 1;
+    return total;
+}
+
+static unsigned char sms_size_code(int total) {
+    switch (total) {
+    case 0x8000: return 0xc;
+    case 0x10000: return 0xe;
+    case 0x20000: return 0xf;
+    default: return 0x0;
+    }
+}
+
+static void sms_header(unsigned char *buf, int total) {
     unsigned short sum = 0;
     for (int i = 0; i < 0x7ff0; i++) {
 	sum += buf[i];
     }
+    for (int i = 0x8000; i < total; i++) {
+	sum += buf[i];
+    }
     printf("SUM=[%04x]\n", sum);
-    strcpy(buf + 0x7ff0, "TMR SEGA");
+    memcpy(buf + 0x7ff0, "TMR SEGA", 8);
     buf[0x7ffa] = sum & 0xff;
     buf[0x7ffb] = sum >> 8;
-    buf[0x7fff] = 0x4c; /* export 32KB */
+    buf[0x7fff] = 0x40 | sms_size_code(total); /* export region */
+}
+
+/* usage: mkrom [-m] [banks.bin] */
+int main(int argc, char **argv) {
+    int msx = argc > 1 && strcmp(argv[1], "-m") == 0;
+    const char *banks = argc > 1 + msx ? argv[1 + msx] : NULL;
+
+    int code = file_size(file);
+    int limit = msx ? (banks ? 0x6000 : 0x8000) : 0x7ff0;
+    if (code > limit) {
+	printf("ERROR \"%s\" too large\n", file);
+	exit(-ENOENT);
+    }
+
+    int start = msx && banks ? 0x6000 : 0x8000;
+    int extra = banks ? file_size(banks) : 0;
+    int total = rom_size(start + extra);
+    unsigned char *buf = calloc(total, 1);
+
+    load(file, buf, code);
+    if (banks) load(banks, buf + start, extra);
+
+    if (!msx) sms_header(buf, total);
 
-    int fd = open("grazers.sms", O_CREAT | O_RDWR, 0644);
+    int fd = open(msx ? "grazers.rom" : "grazers.sms",
+		  O_CREAT | O_TRUNC | O_RDWR, 0644);
     if (fd >= 0) {
-	write(fd, buf, 0x8000);
+	write(fd, buf, total);
 	close(fd);
     }
 
+    free(buf);
     return 0;
 }
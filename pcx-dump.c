@@ -1,25 +1,115 @@
 #include <sys/stat.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <math.h>
 
-static char *file_name;
-static int need_compress = 0;
-static int need_color = 1;
-static int as_level = 0;
-
-static int *tile_idx = NULL;
-static int tile_count = 0;
-
 struct Header {
     unsigned short w, h;
-} header;
+};
+
+struct Tileset {
+    unsigned char *pixel;
+    unsigned char *color;
+    int pixel_size;
+    int color_size;
+    int *remap;
+    int remap_size;
+};
+
+struct Blob {
+    char name[256];
+    unsigned char *data;
+    int size;
+    int bank;
+    int offset;
+};
+
+struct Target {
+    const char *name;
+    int bank_addr;
+    int bank_size;
+    int first_bank;
+    int group_files;
+};
+
+enum { T_ZXS, T_SMS, T_MSX, T_C64, TARGETS };
+
+/* bank_size 0: no banked builds, group_files: each group is a file on disk */
+static const struct Target targets[TARGETS] = {
+    { "ZXS", 0x0000, 0x0000, 0, 0 },
+    { "SMS", 0x8000, 0x4000, 2, 0 },
+    { "MSX", 0xa000, 0x2000, 3, 0 },
+    { "C64", 0xc000, 0x1000, 1, 1 },
+};
+
+struct Job {
+    char mode;
+    int target;
+    char *file_name;
+    int need_color;
+    int fold_flips;
+    int bank;
+    char *over;
+    int slot;
+    int first;
+    int last;
+    unsigned char rows[8];
+
+    struct Tileset set;
+    struct Job *tileset;
+
+    struct Blob blob[2];
+    int blobs;
+
+    unsigned long long key;
+    struct Job *same;
+};
+
+/* PCX scanlines are decoded 8 at a time into a band of w * 8 pixels */
+struct Stream {
+    FILE *file;
+    struct Header header;
+    unsigned char palette[768];
+    int line_size;
+    int count;
+    unsigned char value;
+    unsigned char *band;
+};
 
-static unsigned char *read_pcx(const char *file, int zx_color);
+static const char *cache_dir = ".pcx-cache";
+static unsigned long long build_id;
+
+/* map cells of a level, run-length coded as they are read band by band */
+struct Runs {
+    int *run;
+    int *len;
+    int count;
+    int size;
+};
+
+static int open_pcx(struct Stream *pcx, const char *file);
+static unsigned char *read_band(struct Stream *pcx);
+static unsigned char *color_band(struct Stream *pcx, int target);
+static void close_pcx(struct Stream *pcx);
+
+/* names end up in cache and asset paths, a truncated one is an error */
+static void print_name(char *buf, int size, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buf, size, format, args);
+    va_end(args);
+    if (length < 0 || length >= size) {
+	fprintf(stderr, "ERROR: name too long \"%s\"\n", buf);
+	exit(-1);
+    }
+}
 
 static void hexdump(unsigned char *buf, int size) {
     for (int i = 0; i < size; i++) {
@@ -73,47 +163,28 @@ static unsigned short on_pixel(unsigned char *buf, int i, int w) {
     return pixel == 0 ? 0x1 : pixel;
 }
 
-static int ink_index(int i) {
-    return (i / header.w / 8) * (header.w / 8) + i % header.w / 8;
-}
-
-static unsigned char encode_ink(unsigned short colors) {
-#if defined(MSX) || defined(C64)
-    return ((colors & 0xff) << 4) | (colors >> 8);
-#else
+static unsigned char encode_ink(unsigned short colors, int target) {
+    if (target == T_MSX || target == T_C64) {
+	return ((colors & 0xff) << 4) | (colors >> 8);
+    }
     unsigned char b = colors >> 8;
     unsigned char f = colors & 0xff;
     unsigned char l = (f > 7 || b > 7) ? 0x40 : 0x00;
     return l | (f & 7) | ((b & 7) << 3);
-#endif
 }
 
-static void dump_buffer(void *ptr, int size, int step) {
+static void dump_buffer(FILE *out, void *ptr, int size, int step) {
     for (int i = 0; i < size; i++) {
 	if (step == 1) {
-	    printf(" 0x%02x,", * (unsigned char *) ptr);
+	    fprintf(out, " 0x%02x,", * (unsigned char *) ptr);
 	}
 	else {
-	    printf(" 0x%04x,", * (unsigned short *) ptr);
+	    fprintf(out, " 0x%04x,", * (unsigned short *) ptr);
 	}
-	if ((i & 7) == 7) printf("\n");
+	if ((i & 7) == 7) fprintf(out, "\n");
 	ptr += step;
     }
-    if ((size & 7) != 0) printf("\n");
-}
-
-static void convert_to_stripe(int w, int h, unsigned char *output) {
-    int n = 0;
-    int size = w * h / 8;
-    unsigned char tmp[size];
-    for (int y = 0; y < h; y += 8) {
-	for (int x = 0; x < w / 8; x++) {
-	    for (int i = 0; i < 8; i++) {
-		tmp[n++] = output[((y + i) * w / 8) + x];
-	    }
-	}
-    }
-    memcpy(output, tmp, size);
+    if ((size & 7) != 0) fprintf(out, "\n");
 }
 
 static unsigned char flip_bits(unsigned char source) {
@@ -139,19 +210,17 @@ static int matchDIR(void *pixel, int n, unsigned char *tiles, int i, int d) {
     return *ptr == flip;
 }
 
-#ifdef MSX
-#define MATCH 1
-#else
-#define MATCH 4
-#endif
+static int match_dirs(int target) {
+    return target == T_MSX ? 1 : 4;
+}
 
 static int match(unsigned char *pixel,
 		 unsigned char *tiles,
 		 unsigned char *color,
 		 unsigned char *extra,
-		 int n, int i) {
+		 int n, int i, int dirs) {
 
-    for (int dir = 0; dir < MATCH; dir++) {
+    for (int dir = 0; dir < dirs; dir++) {
 	if (matchDIR(pixel, n, tiles, i, dir)) {
 	    return color[n / 8] == extra[i / 8] ? dir + 1 : 0;
 	}
@@ -159,147 +228,356 @@ static int match(unsigned char *pixel,
     return 0;
 }
 
-static void compress(unsigned char *pixel, int *pixel_size,
-		     unsigned char *color, int *color_size) {
+/* tiles of the band not yet in the set are appended to it, fresh gets
+   their cells in the band */
+static int compress_band(struct Job *job, int cells, int *fresh,
+			 unsigned char *pixel, unsigned char *color) {
 
-    int compress_size = 0;
-    unsigned char tiles[*pixel_size];
-    unsigned char extra[*color_size];
-    for (int n = 0; n < *pixel_size; n += 8) {
+    struct Tileset *set = &job->set;
+    int dirs = match_dirs(job->target);
+    int count = 0;
+    for (int n = 0; n < cells * 8; n += 8) {
 	int have_match = 0;
-	for (int i = 0; i < compress_size; i += 8) {
-	    if (match(pixel, tiles, color, extra, n, i)) {
+	for (int i = 0; i < set->pixel_size; i += 8) {
+	    if (match(pixel, set->pixel, color, set->color, n, i, dirs)) {
 		have_match = 1;
 		break;
 	    }
 	}
 	if (!have_match) {
-	    tile_idx[tile_count++] = n / 8;
-	    memcpy(tiles + compress_size, pixel + n, 8);
-	    extra[compress_size / 8] = color[n / 8];
-	    compress_size += 8;
+	    set->pixel = realloc(set->pixel, set->pixel_size + 8);
+	    set->color = realloc(set->color, set->color_size + 1);
+	    fresh[count++] = n / 8;
+	    memcpy(set->pixel + set->pixel_size, pixel + n, 8);
+	    set->color[set->color_size++] = color[n / 8];
+	    set->pixel_size += 8;
 	}
     }
-    *pixel_size = compress_size;
-    memcpy(pixel, tiles, *pixel_size);
-    *color_size = compress_size / 8;
-    memcpy(color, extra, *color_size);
+    return count;
+}
 
-    fprintf(stderr, "IMAGE %s %d\n", file_name, *color_size);
+#define NO_TILE -1
+#define BASES 64
 
-    int fd = open("tileset.bin", O_CREAT | O_RDWR, 0644);
-    if (fd >= 0) {
-	write(fd, pixel_size, sizeof(int));
-	write(fd, pixel, *pixel_size);
-	write(fd, color_size, sizeof(int));
-	write(fd, color, *color_size);
-	close(fd);
+static void add_runs(struct Runs *runs, int *cell, int cells) {
+    for (int n = 0; n < cells; n++) {
+	if (runs->count > 0 && runs->run[runs->count - 1] == cell[n]) {
+	    runs->len[runs->count - 1]++;
+	    continue;
+	}
+	if (runs->count == runs->size) {
+	    runs->size = runs->size ? 2 * runs->size : 64;
+	    runs->run = realloc(runs->run, runs->size * sizeof(int));
+	    runs->len = realloc(runs->len, runs->size * sizeof(int));
+	}
+	runs->run[runs->count] = cell[n];
+	runs->len[runs->count++] = 1;
     }
 }
 
-static void rle_encode(unsigned char *pixel, unsigned char *table, int *size) {
-    int count = 0, done = 0;
-    unsigned char prev = 0xff;
-    void encode_pixel(void) {
-	if (count > 1) {
-	    pixel[done++] = 0x80 | count;
-	}
-	pixel[done++] = prev;
-    }
-    for (int i = 0; i < *size; i++) {
-	if (table[i] == prev && count < 63) {
+/* size of the stream when every cell out of reach switches base */
+static int greedy_level(struct Runs *runs) {
+    int base = 0, done = 0, count = 0, prev = -1;
+    void encode_pixel(int data) {
+	if (data == prev && count < 63) {
 	    count++;
+	    return;
 	}
-	else {
-	    if (prev < 0xff) {
-		encode_pixel();
+	if (prev >= 0) done += count > 1 ? 2 : 1;
+	prev = data;
+	count = 1;
+    }
+    for (int g = 0; g < runs->count; g++) {
+	int cell = runs->run[g];
+	int index = cell & 0xff;
+	for (int n = 0; n < runs->len[g]; n++) {
+	    if (cell == NO_TILE) {
+		encode_pixel(0);
+		continue;
 	    }
-	    count = 1;
+	    if (index > base + 31 || index < base) {
+		base = index & 0xf8;
+		encode_pixel(0xc0 | (base >> 2));
+	    }
+	    encode_pixel((index - base) | ((cell >> 8) << 5));
 	}
-	prev = table[i];
     }
-    encode_pixel();
-    *size = done;
+    encode_pixel(-1);
+    return done;
+}
+
+static int run_cost(int count) {
+    int rest = count % 63;
+    return 2 * (count / 63) + (rest == 0 ? 0 : (rest == 1 ? 1 : 2));
 }
 
-static void to_level(unsigned char *pixel, int *pixel_size,
-		     unsigned char *color, int *color_size) {
+static int fits_base(int cell, int base) {
+    int index = cell & 0xff;
+    return cell == NO_TILE || (base <= index && index <= base + 31);
+}
 
-    int tiles_size, extra_size;
-    unsigned char tiles[*pixel_size];
-    unsigned char extra[*color_size];
-    unsigned char table[*color_size * 2];
+/* cheapest stream for raw_image(), choosing a base for every run of
+   equal cells: cost[g][b] is the size up to run g drawn with base 4*b */
+static unsigned char *optimal_level(struct Runs *runs, int *size) {
+    int groups = runs->count;
+    int *run = runs->run;
+    int *len = runs->len;
 
-    int fd = open("tileset.bin", O_RDONLY, 0644);
-    if (fd >= 0) {
-	read(fd, &tiles_size, sizeof(int));
-	read(fd, tiles, tiles_size);
-	read(fd, &extra_size, sizeof(int));
-	read(fd, extra, extra_size);
-	close(fd);
+    int (*cost)[BASES] = malloc(groups * sizeof(*cost));
+    unsigned char (*from)[BASES] = malloc(groups * sizeof(*from));
+    for (int g = 0; g < groups; g++) {
+	int *prev = g > 0 ? cost[g - 1] : NULL;
+	int best = 0;
+	for (int b = 1; prev != NULL && b < BASES; b++) {
+	    if (prev[b] < prev[best]) best = b;
+	}
+	int switch_cost = (prev ? prev[best] : 0) + 1;
+	for (int b = 0; b < BASES; b++) {
+	    int stay = prev ? prev[b] : (b == 0 ? 0 : INT_MAX);
+	    cost[g][b] = INT_MAX;
+	    if (!fits_base(run[g], b << 2)) continue;
+	    if (stay <= switch_cost) {
+		cost[g][b] = stay + run_cost(len[g]);
+		from[g][b] = b;
+	    }
+	    else {
+		cost[g][b] = switch_cost + run_cost(len[g]);
+		from[g][b] = best;
+	    }
+	}
     }
-    else {
-	fprintf(stderr, "ERROR: missing tileset.bin\n");
+
+    int *base = malloc(groups * sizeof(int));
+    int b = 0;
+    for (int i = 1; i < BASES; i++) {
+	if (cost[groups - 1][i] < cost[groups - 1][b]) b = i;
+    }
+    *size = cost[groups - 1][b];
+    for (int g = groups - 1; g >= 0; g--) {
+	base[g] = b;
+	b = from[g][b];
+    }
+
+    unsigned char *pixel = malloc(*size);
+    int done = 0, last = 0;
+    for (int g = 0; g < groups; g++) {
+	if (base[g] != last) {
+	    last = base[g];
+	    pixel[done++] = 0xc0 | last;
+	}
+	unsigned char data = 0;
+	if (run[g] != NO_TILE) {
+	    data = ((run[g] & 0xff) - (last << 2)) | ((run[g] >> 8) << 5);
+	}
+	for (int left = len[g]; left > 0; left -= 63) {
+	    if (left > 1) pixel[done++] = 0x80 | (left > 63 ? 63 : left);
+	    pixel[done++] = data;
+	}
+    }
+    if (done != *size) {
+	fprintf(stderr, "ERROR: level size %d, expected %d\n", done, *size);
 	exit(-1);
     }
 
-    int base = 0, done = 0;
-    for (int n = 0; n < *pixel_size; n += 8) {
-	int found = 0;
+    free(base);
+    free(cost);
+    free(from);
+    return pixel;
+}
+
+static void level_band(struct Job *job, int first, int cells, int *cell,
+		       unsigned char *pixel, unsigned char *color) {
+
+    if (job->tileset == NULL) {
+	fprintf(stderr, "ERROR: (%s) missing tileset\n", job->file_name);
+	exit(-1);
+    }
+    int tiles_size = job->tileset->set.pixel_size;
+    unsigned char *tiles = job->tileset->set.pixel;
+    unsigned char *extra = job->tileset->set.color;
+
+    int dirs = match_dirs(job->target);
+    for (int n = 0; n < cells * 8; n += 8) {
+	cell[n / 8] = NO_TILE;
 	for (int i = 0; i < tiles_size; i += 8) {
-	    int matching = match(pixel, tiles, color, extra, n, i);
+	    int matching = match(pixel, tiles, color, extra, n, i, dirs);
 	    if (matching) {
 		int index = (i / 8);
-		if (index > 256) {
+		if (index > 255) {
 		    fprintf(stderr, "ERROR: too many tiles\n");
 		    exit(-1);
 		}
-		if (index > base + 31) {
-		    base = index & 0xf8;
-		    table[done++] = 0xc0 | (base >> 2);
-		}
-		if (index < base) {
-		    base = index & 0xf8;
-		    table[done++] = 0xc0 | (base >> 2);
-		}
-		table[done++] = (index - base) | ((matching - 1) << 5);
-		found = 1;
+		cell[n / 8] = index | ((matching - 1) << 8);
 		break;
 	    }
 	}
-	if (!found) {
-	    int x = (n % header.w) / 8;
-	    int y = (n / header.w);
+	if (cell[n / 8] == NO_TILE) {
+	    int x = n / 8;
+	    int y = first / cells;
 	    fprintf(stderr, "ERROR: (%s) tile not found (%d,%d)\n",
-		    file_name, x, y);
-#ifdef MSX
-	    table[done++] = 0;
-#else
-	    exit(-1);
-#endif
+		    job->file_name, x, y);
+	    if (job->target != T_MSX) exit(-1);
 	}
     }
 
-    *pixel_size = done;
-    rle_encode(pixel, table, pixel_size);
+    int *remap = job->tileset->set.remap;
+    for (int n = 0; remap != NULL && n < cells; n++) {
+	if (cell[n] != NO_TILE) cell[n] = remap[cell[n] & 0xff] ^ (cell[n] & ~0xff);
+    }
+}
+
+static unsigned char *to_level(struct Job *job, struct Runs *runs, int *size) {
+    int greedy_size = greedy_level(runs);
+    unsigned char *map = optimal_level(runs, size);
+    fprintf(stderr, "LEVEL %s %d bytes, greedy %d, saved %d\n",
+	    job->file_name, *size, greedy_size, greedy_size - *size);
+    return map;
 }
 
-static void save(unsigned char *pixel, int pixel_size,
+static void keep_blob(struct Job *job, const char *name, const char *suffix,
+		      unsigned char *data, int size) {
+    struct Blob *blob = job->blob + job->blobs++;
+    print_name(blob->name, sizeof(blob->name), "%s%s", name, suffix);
+    blob->data = malloc(size);
+    memcpy(blob->data, data, size);
+    blob->size = size;
+}
+
+/* MSX colour tables have a byte per tile row, as VRAM has them,
+   batch() packs them into runs once the -r rows are painted */
+static int row_colors(int target) {
+    return target == T_MSX;
+}
+
+static void save(struct Job *job,
+		 unsigned char *pixel, int pixel_size,
 		 unsigned char *color, int color_size) {
 
     char name[256];
-    remove_extension(file_name, name);
-    printf("const byte %s%s[] = {\n", name, as_level ? "_map" : "");
-    dump_buffer(pixel, pixel_size, 1);
-    printf("};\n");
-    if (color != NULL && need_color && !as_level) {
-	printf("const byte %s_color[] = {\n", name);
-	dump_buffer(color, color_size, 1);
-	printf("};\n");
+    int as_level = job->mode == 'l';
+    remove_extension(job->file_name, name);
+    keep_blob(job, name, as_level ? "_map" : "", pixel, pixel_size);
+    if (color != NULL && job->need_color && !as_level) {
+	int rows = row_colors(job->target) ? 8 : 1;
+	unsigned char *table = malloc(color_size * rows);
+	for (int i = 0; i < color_size * rows; i++) {
+	    table[i] = color[i / rows];
+	}
+	keep_blob(job, name, "_color", table, color_size * rows);
+	free(table);
+    }
+}
+
+static void emit_text(FILE *out, struct Blob *blob) {
+    fprintf(out, "const byte %s[] = {\n", blob->name);
+    dump_buffer(out, blob->data, blob->size, 1);
+    fprintf(out, "};\n");
+}
+
+/* blobs sit next to assets.s, which includes them relative to itself */
+static void emit_binary(FILE *out, FILE *as, const char *dir,
+			struct Blob *blob) {
+    char path[512];
+    print_name(path, sizeof(path), "%s/%s.bin", dir, blob->name);
+    int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0 || write(fd, blob->data, blob->size) != blob->size) {
+	fprintf(stderr, "ERROR while writing \"%s\"\n", path);
+	exit(-1);
     }
+    close(fd);
+    fprintf(out, "extern const byte %s[%d];\n", blob->name, blob->size);
+    fprintf(as, "_%s::\n\t.incbin \"%s.bin\"\n", blob->name, blob->name);
 }
 
-static void encode_sms_tile(unsigned char *dst, unsigned char *src) {
+struct Banks {
+    unsigned char *data;
+    int count;
+    int fill[256];
+};
+
+/* pack bank=N groups into switchable banks, first fit in manifest order */
+static int layout_banks(struct Job *jobs, int count,
+			const struct Target *t, struct Banks *banks) {
+    int size[256] = { 0 }, phys[256] = { 0 }, base[256];
+    int bank = t->first_bank, fill = 0;
+    for (int i = 0; i < count; i++) {
+	int group = jobs[i].bank & 0xff;
+	for (int j = 0; j < jobs[i].blobs; j++) {
+	    size[group] += jobs[i].blob[j].size;
+	}
+    }
+    for (int i = 0; i < count; i++) {
+	int group = jobs[i].bank & 0xff;
+	if (group == 0 || phys[group] > 0) continue;
+	if (size[group] > t->bank_size) {
+	    fprintf(stderr, "ERROR: bank=%d is %d bytes\n", group, size[group]);
+	    return -EFBIG;
+	}
+	if (fill + size[group] > t->bank_size || (t->group_files && fill > 0)) {
+	    bank++;
+	    fill = 0;
+	}
+	phys[group] = bank;
+	base[group] = fill;
+	fill += size[group];
+	banks->fill[bank - t->first_bank] = fill;
+	fprintf(stderr, "BANK %d group %d, %d bytes\n", bank, group, size[group]);
+    }
+    for (int i = 0; i < count; i++) {
+	int group = jobs[i].bank & 0xff;
+	for (int j = 0; group > 0 && j < jobs[i].blobs; j++) {
+	    struct Blob *blob = jobs[i].blob + j;
+	    blob->bank = phys[group];
+	    blob->offset = base[group];
+	    base[group] += blob->size;
+	}
+    }
+    banks->count = fill > 0 ? bank - t->first_bank + 1 : 0;
+    banks->data = calloc(banks->count + 1, t->bank_size);
+    return 0;
+}
+
+static void emit_banked(FILE *out, struct Blob *blob,
+			const struct Target *t, struct Banks *banks) {
+    int offset = (blob->bank - t->first_bank) * t->bank_size + blob->offset;
+    memcpy(banks->data + offset, blob->data, blob->size);
+    fprintf(out, "#define %s_bank %d\n", blob->name, blob->bank);
+    fprintf(out, "__at(0x%04x) const byte %s[%d];\n",
+	    t->bank_addr + blob->offset, blob->name, blob->size);
+}
+
+static void save_bank_files(const char *dir,
+			    const struct Target *t, struct Banks *banks) {
+    char path[512];
+    unsigned char addr[2] = { t->bank_addr & 0xff, t->bank_addr >> 8 };
+    for (int i = 0; i < banks->count; i++) {
+	print_name(path, sizeof(path), "%s/bank%02d.prg",
+		   dir, t->first_bank + i);
+	int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+	if (fd >= 0) {
+	    write(fd, addr, sizeof(addr));
+	    write(fd, banks->data + i * t->bank_size, banks->fill[i]);
+	    close(fd);
+	}
+    }
+}
+
+static void save_banks(const char *dir,
+		       const struct Target *t, struct Banks *banks) {
+    if (t->group_files) {
+	save_bank_files(dir, t, banks);
+	return;
+    }
+    char path[512];
+    print_name(path, sizeof(path), "%s/banks.bin", dir);
+    int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd >= 0) {
+	write(fd, banks->data, banks->count * t->bank_size);
+	close(fd);
+    }
+}
+
+static void encode_sms_tile(unsigned char *dst, unsigned char *src, int w) {
     for (int y = 0; y < 8; y++) {
 	for (int x = 0; x < 8; x++) {
 	    unsigned char pixel = src[x];
@@ -310,79 +588,171 @@ static void encode_sms_tile(unsigned char *dst, unsigned char *src) {
 		dst[i] |= (((pixel >> i) & 1) << (7 - x));
 	    }
 	}
-	src += header.w;
+	src += w;
 	dst += 4;
     }
 }
 
-static void full_tileset(void) {
-    tile_count = header.w * header.h / 64;
+static void flip_sms_tile(unsigned char *dst, unsigned char *src, int dir) {
+    for (int y = 0; y < 8; y++) {
+	unsigned char *row = src + 4 * ((dir & 2) ? 7 - y : y);
+	for (int i = 0; i < 4; i++) {
+	    dst[4 * y + i] = (dir & 1) ? flip_bits(row[i]) : row[i];
+	}
+    }
 }
 
-static int good_tile(int index) {
-    for (int i = 0; i < tile_count; i++) {
-	if (tile_idx[i] == index) return 1;
+/* drop SMS tiles that are copies or flips of an earlier tile, remap[]
+   tells levels which tile and name table flip bits to use instead */
+static int fold_sms_flips(struct Tileset *set, unsigned char *tiles, int count) {
+    int kept = 0;
+    set->remap = malloc(count * sizeof(int));
+    set->remap_size = count;
+    for (int i = 0; i < count; i++) {
+	unsigned char flip[32];
+	set->remap[i] = -1;
+	for (int dir = 0; dir < 4 && set->remap[i] < 0; dir++) {
+	    flip_sms_tile(flip, tiles + 32 * i, dir);
+	    for (int j = 0; j < kept; j++) {
+		if (memcmp(flip, tiles + 32 * j, 32) == 0) {
+		    set->remap[i] = j | (dir << 8);
+		    break;
+		}
+	    }
+	}
+	if (set->remap[i] < 0) {
+	    memmove(tiles + 32 * kept, tiles + 32 * i, 32);
+	    set->remap[i] = kept++;
+	}
     }
-    return 0;
+    if (kept < count) {
+	fprintf(stderr, "FOLDED %d of %d tiles\n", count - kept, count);
+    }
+    return kept;
 }
 
-static int save_sms_tileset(void) {
-    int offset = 0;
+static int open_sms(struct Stream *pcx, const char *file) {
     char name[256], sms_name[256];
-    remove_extension(file_name, name);
-    sprintf(sms_name, "%s-sms.pcx", name);
-    unsigned char *buf = read_pcx(sms_name, 0);
-    if (buf == NULL) return -ENOENT;
-
-    if (tile_idx == NULL) full_tileset();
-    unsigned char sms_tiles[32 * tile_count];
-    memset(sms_tiles, 0, 32 * tile_count);
-
-    int index = 0;
-    for (int y = 0; y < header.h; y += 8) {
-	for (int x = 0; x < header.w; x += 8) {
-	    if (tile_idx == NULL || good_tile(index)) {
-		encode_sms_tile(sms_tiles + offset, buf + (y * header.w) + x);
-		offset += 32;
-	    }
-	    index++;
+    remove_extension((char *) file, name);
+    print_name(sms_name, sizeof(sms_name), "%s-sms.pcx", name);
+    return open_pcx(pcx, sms_name);
+}
+
+static void save_sms_tiles(struct Job *job, unsigned char *tiles, int count) {
+    if (job->fold_flips) {
+	count = fold_sms_flips(&job->set, tiles, count);
+    }
+    save(job, tiles, 32 * count, NULL, 0);
+}
+
+/* -s: every tile of the -sms.pcx, a band at a time */
+static int save_sms_tileset(struct Job *job) {
+    struct Stream pcx;
+    if (open_sms(&pcx, job->file_name) < 0) return -ENOENT;
+
+    int w = pcx.header.w, count = 0;
+    unsigned char *sms_tiles = NULL;
+    for (int y = 0; y < pcx.header.h; y += 8) {
+	unsigned char *band = read_band(&pcx);
+	sms_tiles = realloc(sms_tiles, 32 * (count + w / 8));
+	memset(sms_tiles + 32 * count, 0, 4 * w);
+	for (int x = 0; x < w; x += 8) {
+	    encode_sms_tile(sms_tiles + 32 * count++, band + x, w);
 	}
     }
-    save(sms_tiles, 32 * tile_count, NULL, 0);
-    free(buf);
+    close_pcx(&pcx);
+    save_sms_tiles(job, sms_tiles, count);
+    free(sms_tiles);
     return 0;
 }
 
-static void save_bitmap(unsigned char *buf, int size) {
-    int j = 0;
-    int pixel_size = size / 8;
-    int color_size = size / 64;
-    unsigned char pixel[pixel_size];
-    unsigned char color[color_size];
-    unsigned short on[color_size];
-    for (int i = 0; i < size; i += 8) {
-	if (i / header.w % 8 == 0) {
-	    on[j++] = on_pixel(buf, i, header.w);
-	}
-	unsigned char data = on[ink_index(i)] & 0xff;
-	pixel[i / 8] = consume_pixels(buf + i, data);
+/* SMS tilesets keep the tiles of the -sms.pcx where the new ones are */
+static void add_sms_tiles(struct Stream *sms, int y, int *fresh, int count,
+			  unsigned char **tiles, int *size) {
+    unsigned char *band = y < sms->header.h ? read_band(sms) : NULL;
+    *tiles = realloc(*tiles, 32 * (*size + count));
+    memset(*tiles + 32 * *size, 0, 32 * count);
+    for (int i = 0; band != NULL && i < count; i++) {
+	encode_sms_tile(*tiles + 32 * (*size + i), band + 8 * fresh[i],
+			sms->header.w);
     }
-    for (int i = 0; i < color_size; i++) {
-	color[i] = encode_ink(on[i]);
+    *size += count;
+}
+
+/* the job streams its image a band at a time, memory does not grow with
+   its height, only with the tiles and map runs it keeps */
+static int save_bitmap(struct Job *job) {
+    struct Stream pcx, sms = { NULL };
+    if (open_pcx(&pcx, job->file_name) < 0) return -ENOENT;
+    if (job->mode == 'c' && job->target == T_SMS) {
+	if (open_sms(&sms, job->file_name) < 0) {
+	    sms.file = NULL;
+	}
+	else if (sms.header.w != pcx.header.w) {
+	    fprintf(stderr, "ERROR: (%s) -sms.pcx width differs\n",
+		    job->file_name);
+	    exit(-1);
+	}
     }
 
-    convert_to_stripe(header.w, header.h, pixel);
+    struct Header *header = &pcx.header;
+    int cells = header->w / 8;
+    int count = cells * (header->h / 8);
+    unsigned char *pixel = malloc(cells * 9);
+    unsigned char *color = pixel + cells * 8;
+    int *cell = malloc(cells * sizeof(int));
+    struct Runs runs = { NULL };
+    unsigned char *sms_tiles = NULL;
+    int sms_count = 0;
 
-    if (as_level) {
-	to_level(pixel, &pixel_size, color, &color_size);
+    for (int first = 0; first < count; first += cells) {
+	unsigned char *band = color_band(&pcx, job->target);
+	for (int x = 0; x < cells; x++) {
+	    unsigned short on = on_pixel(band, x * 8, header->w);
+	    unsigned char *ptr = band + x * 8;
+	    for (int y = 0; y < 8; y++) {
+		pixel[x * 8 + y] = consume_pixels(ptr, on & 0xff);
+		ptr += header->w;
+	    }
+	    color[x] = encode_ink(on, job->target);
+	}
+	if (job->mode == 'l') {
+	    level_band(job, first, cells, cell, pixel, color);
+	    add_runs(&runs, cell, cells);
+	}
+	if (job->mode == 'c') {
+	    int fresh = compress_band(job, cells, cell, pixel, color);
+	    if (sms.file != NULL) {
+		add_sms_tiles(&sms, first / cells * 8, cell, fresh,
+			      &sms_tiles, &sms_count);
+	    }
+	}
+    }
+    close_pcx(&pcx);
+
+    if (job->mode == 'l') {
+	int size;
+	unsigned char *map = to_level(job, &runs, &size);
+	save(job, map, size, NULL, 0);
+	free(map);
+	free(runs.run);
+	free(runs.len);
     }
-    if (need_compress) {
-	compress(pixel, &pixel_size, color, &color_size);
-#ifdef SMS
-	if (save_sms_tileset() >= 0) return;
-#endif
+    if (job->mode == 'c') {
+	struct Tileset *set = &job->set;
+	fprintf(stderr, "IMAGE %s %d\n", job->file_name, set->color_size);
+	if (sms.file != NULL) {
+	    close_pcx(&sms);
+	    save_sms_tiles(job, sms_tiles, sms_count);
+	    free(sms_tiles);
+	}
+	else {
+	    save(job, set->pixel, set->pixel_size, set->color, set->color_size);
+	}
     }
-    save(pixel, pixel_size, color, color_size);
+    free(pixel);
+    free(cell);
+    return 0;
 }
 
 const unsigned char msx_look_up[] = {
@@ -395,108 +765,666 @@ const unsigned char c64_look_up[] = {
     0x06, 0x09, 0x02, 0x0a, 0x0c, 0x0d, 0x07, 0x01,
 };
 
-static unsigned char get_color(unsigned char *color) {
+static unsigned char get_color(unsigned char *color, int target) {
     unsigned char result = 0;
+    int nibble = target == T_MSX || target == T_C64;
     if (color[0] >= 0x80) result |= 0x02;
     if (color[1] >= 0x80) result |= 0x04;
     if (color[2] >= 0x80) result |= 0x01;
     for (int i = 0; i < 3; i++) {
 	if (color[i] > (result ? 0xf0 : 0x40)) {
-#if defined(MSX) || defined(C64)
-	    result |= 0x08;
-#else
-	    result |= 0x40;
-#endif
+	    result |= nibble ? 0x08 : 0x40;
 	    break;
 	}
     }
-#ifdef MSX
-    return msx_look_up[result];
-#elif defined(C64)
-    return c64_look_up[result];
-#else
-    return result;
-#endif
+    switch (target) {
+    case T_MSX:
+	return msx_look_up[result];
+    case T_C64:
+	return c64_look_up[result];
+    default:
+	return result;
+    }
 }
 
-static unsigned char *read_pcx(const char *file, int zx_color) {
-    struct stat st;
-    int palette_offset = 16;
-    if (stat(file, &st) != 0) {
+static int open_pcx(struct Stream *pcx, const char *file) {
+    unsigned char head[128];
+    memset(pcx, 0, sizeof(*pcx));
+    pcx->file = fopen(file, "rb");
+    if (pcx->file == NULL || fread(head, 1, 128, pcx->file) != 128) {
 	fprintf(stderr, "ERROR while opening PCX-file \"%s\"\n", file);
-	return NULL;
+	if (pcx->file != NULL) fclose(pcx->file);
+	pcx->file = NULL;
+	return -ENOENT;
+    }
+
+    pcx->header.w = (* (unsigned short *) (head + 0x8)) + 1;
+    pcx->header.h = (* (unsigned short *) (head + 0xa)) + 1;
+    pcx->line_size = * (unsigned short *) (head + 0x42);
+    memcpy(pcx->palette, head + 16, 48);
+    if (head[3] == 8) {
+	fseek(pcx->file, -768, SEEK_END);
+	fread(pcx->palette, 1, 768, pcx->file);
+	fseek(pcx->file, 128, SEEK_SET);
+    }
+    if (pcx->line_size < pcx->header.w) pcx->line_size = pcx->header.w;
+    pcx->band = malloc(pcx->header.w * 8);
+    return 0;
+}
+
+static unsigned char next_pixel(struct Stream *pcx) {
+    if (pcx->count == 0) {
+	int data = fgetc(pcx->file);
+	pcx->count = 1;
+	if ((data & 0xc0) == 0xc0) {
+	    pcx->count = data & 0x3f;
+	    data = fgetc(pcx->file);
+	}
+	pcx->value = data;
+    }
+    pcx->count--;
+    return pcx->value;
+}
+
+static unsigned char *read_band(struct Stream *pcx) {
+    unsigned char *ptr = pcx->band;
+    for (int y = 0; y < 8; y++) {
+	for (int x = 0; x < pcx->line_size; x++) {
+	    unsigned char pixel = next_pixel(pcx);
+	    if (x >= pcx->header.w) continue;
+	    *ptr++ = pixel;
+	}
+    }
+    return pcx->band;
+}
+
+static void close_pcx(struct Stream *pcx) {
+    fclose(pcx->file);
+    free(pcx->band);
+}
+
+/* the next band with its palette indices turned into target colours */
+static unsigned char *color_band(struct Stream *pcx, int target) {
+    unsigned char *band = read_band(pcx);
+    for (int i = 0; i < pcx->header.w * 8; i++) {
+	band[i] = get_color(pcx->palette + band[i] * 3, target);
+    }
+    return band;
+}
+
+static unsigned long long hash(unsigned long long h, const void *ptr, int size) {
+    const unsigned char *data = ptr;
+    for (int i = 0; i < size; i++) {
+	h = (h ^ data[i]) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+static unsigned long long hash_file(unsigned long long h, const char *file) {
+    unsigned char buf[4096];
+    int size, in = open(file, O_RDONLY);
+    if (in < 0) return hash(h, "-", 1);
+    while ((size = read(in, buf, sizeof(buf))) > 0) {
+	h = hash(h, buf, size);
     }
-    unsigned char *buf = malloc(st.st_size);
-    int in = open(file, O_RDONLY);
-    read(in, buf, st.st_size);
     close(in);
+    return h;
+}
+
+/* SMS maps and tiles are encoded like ZXS ones, so they share results */
+static int encoding(int target) {
+    return target == T_SMS ? T_ZXS : target;
+}
+
+static void job_key(struct Job *job) {
+    int class = encoding(job->target);
+    unsigned long long h = hash(build_id, &class, sizeof(int));
+    h = hash(h, &job->mode, 1);
+    h = hash(h, &job->need_color, sizeof(int));
+    h = hash(h, &job->fold_flips, sizeof(int));
+    h = hash(h, job->file_name, strlen(job->file_name) + 1);
+    if (job->mode != 's') {
+	h = hash_file(h, job->file_name);
+    }
+    if (job->target == T_SMS && job->mode != 'l') {
+	char name[256], sms_name[256];
+	remove_extension(job->file_name, name);
+	print_name(sms_name, sizeof(sms_name), "%s-sms.pcx", name);
+	h = hash_file(h, sms_name);
+    }
+    if (job->mode == 'l' && job->tileset != NULL) {
+	struct Tileset *set = &job->tileset->set;
+	h = hash(h, set->pixel, set->pixel_size);
+	h = hash(h, set->color, set->color_size);
+	h = hash(h, set->remap, set->remap_size * sizeof(int));
+    }
+    job->key = h;
+}
+
+static void cache_path(struct Job *job, char *path, int size) {
+    print_name(path, size, "%s/%016llx", cache_dir, job->key);
+}
+
+static int read_chunk(int fd, void **ptr, int *size) {
+    if (read(fd, size, sizeof(int)) != sizeof(int)) return -1;
+    *ptr = malloc(*size + 1);
+    return read(fd, *ptr, *size) == *size ? 0 : -1;
+}
+
+static int load_cache(struct Job *job) {
+    char path[256];
+    cache_path(job, path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -ENOENT;
+    struct Tileset *set = &job->set;
+    int ret = read(fd, &job->blobs, sizeof(int)) == sizeof(int) ? 0 : -1;
+    if (job->blobs > 2) ret = -1;
+    for (int i = 0; ret == 0 && i < job->blobs; i++) {
+	struct Blob *blob = job->blob + i;
+	ret = read(fd, blob->name, sizeof(blob->name)) > 0 ? 0 : -1;
+	if (ret == 0) ret = read_chunk(fd, (void **) &blob->data, &blob->size);
+    }
+    if (ret == 0) ret = read_chunk(fd, (void **) &set->pixel, &set->pixel_size);
+    if (ret == 0) ret = read_chunk(fd, (void **) &set->color, &set->color_size);
+    if (ret == 0) ret = read_chunk(fd, (void **) &set->remap, &set->remap_size);
+    set->remap_size /= sizeof(int);
+    if (set->remap_size == 0) set->remap = NULL;
+    close(fd);
+    if (ret < 0) job->blobs = 0;
+    return ret;
+}
+
+static void write_chunk(int fd, void *ptr, int size) {
+    write(fd, &size, sizeof(int));
+    write(fd, ptr, size);
+}
+
+static void save_cache(struct Job *job) {
+    char path[256], temp[256];
+    cache_path(job, path, sizeof(path));
+    print_name(temp, sizeof(temp), "%s.%d.%lx",
+	       path, getpid(), (long) pthread_self());
+    mkdir(cache_dir, 0755);
+    int fd = open(temp, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd >= 0) {
+	write(fd, &job->blobs, sizeof(int));
+	for (int i = 0; i < job->blobs; i++) {
+	    write(fd, job->blob[i].name, sizeof(job->blob[i].name));
+	    write_chunk(fd, job->blob[i].data, job->blob[i].size);
+	}
+	write_chunk(fd, job->set.pixel, job->set.pixel_size);
+	write_chunk(fd, job->set.color, job->set.color_size);
+	write_chunk(fd, job->set.remap, job->set.remap_size * sizeof(int));
+	close(fd);
+	rename(temp, path);
+    }
+}
+
+static void parse_job(struct Job *job, int target, int argc, char **argv) {
+    memset(job, 0, sizeof(*job));
+    job->target = target;
+    job->mode = argv[0][1];
+    job->file_name = strdup(argv[1]);
+    job->need_color = 1;
+    for (int i = 2; i < argc; i++) {
+	if (strcmp(argv[i], "no-color") == 0) job->need_color = 0;
+	if (strcmp(argv[i], "flip") == 0) job->fold_flips = 1;
+	if (strncmp(argv[i], "bank=", 5) == 0) job->bank = atoi(argv[i] + 5);
+	if (strncmp(argv[i], "over=", 5) == 0) job->over = strdup(argv[i] + 5);
+    }
+    if (job->mode == 'r' && argc > 3) {
+	char *ptr = argv[3];
+	if (sscanf(argv[2], "%d-%d", &job->first, &job->last) < 2) {
+	    job->last = job->first;
+	}
+	for (int i = 0; i < 8; i++) {
+	    job->rows[i] = strtol(ptr, &ptr, 16);
+	    if (*ptr == ',') ptr++;
+	}
+    }
+}
+
+static int run_job(struct Job *job) {
+    if (load_cache(job) == 0) return 0;
+
+    if (job->mode == 's') {
+	save_sms_tileset(job);
+    }
+    else if (save_bitmap(job) < 0) {
+	return -ENOENT;
+    }
+    save_cache(job);
+    return 0;
+}
+
+struct Pool {
+    struct Job **jobs;
+    int count;
+    int next;
+    int failed;
+};
 
-    header.w = (* (unsigned short *) (buf + 0x8)) + 1;
-    header.h = (* (unsigned short *) (buf + 0xa)) + 1;
-    if (buf[3] == 8) palette_offset = st.st_size - 768;
-    int unpacked_size = header.w * header.h / (buf[3] == 8 ? 1 : 2);
-    unsigned char *pixels = malloc(unpacked_size);
-
-    int i = 128, j = 0;
-    while (j < unpacked_size) {
-	if ((buf[i] & 0xc0) == 0xc0) {
-	    int count = buf[i++] & 0x3f;
-	    while (count-- > 0) {
-		pixels[j++] = buf[i];
+static void *worker(void *ptr) {
+    struct Pool *pool = ptr;
+    for (;;) {
+	int i = __sync_fetch_and_add(&pool->next, 1);
+	if (i >= pool->count) break;
+	if (run_job(pool->jobs[i]) < 0) pool->failed = 1;
+    }
+    return NULL;
+}
+
+static int run_pool(struct Job **jobs, int count) {
+    struct Pool pool = { jobs, count, 0, 0 };
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > count) threads = count;
+    if (threads < 1) threads = 1;
+    pthread_t tid[threads];
+    for (int i = 0; i < threads; i++) {
+	pthread_create(tid + i, NULL, &worker, &pool);
+    }
+    for (int i = 0; i < threads; i++) {
+	pthread_join(tid[i], NULL);
+    }
+    return pool.failed ? -ENOENT : 0;
+}
+
+/* jobs of several targets with the same key are only run once */
+static int run_stage(struct Job **stage, int count) {
+    int unique = 0;
+    struct Job *jobs[count];
+    for (int i = 0; i < count; i++) {
+	job_key(stage[i]);
+	stage[i]->same = NULL;
+	for (int j = 0; j < i && stage[i]->same == NULL; j++) {
+	    if (stage[j]->same == NULL && stage[j]->key == stage[i]->key) {
+		stage[i]->same = stage[j];
 	    }
-	    i++;
 	}
-	else {
-	    pixels[j++] = buf[i++];
+	if (stage[i]->same == NULL) jobs[unique++] = stage[i];
+    }
+    if (run_pool(jobs, unique) < 0) return -ENOENT;
+    for (int i = 0; i < count; i++) {
+	struct Job *same = stage[i]->same;
+	if (same == NULL) continue;
+	memcpy(stage[i]->blob, same->blob, sizeof(same->blob));
+	stage[i]->blobs = same->blobs;
+	stage[i]->set = same->set;
+    }
+    return 0;
+}
+
+/* tiles of a -c set as they are stored, SMS ones in planar form */
+struct Tiles {
+    unsigned char *pixel;
+    unsigned char *color;
+    int pixel_step;
+    int color_step;
+    int count;
+};
+
+static void tiles_of(struct Job *job, struct Tiles *tiles) {
+    tiles->pixel_step = job->target == T_SMS ? 32 : 8;
+    tiles->pixel = job->blob[0].data;
+    tiles->count = job->blob[0].size / tiles->pixel_step;
+    tiles->color = job->blobs > 1 ? job->blob[1].data : NULL;
+    tiles->color_step = job->blobs > 1 ? job->blob[1].size / tiles->count : 0;
+}
+
+static struct Job *find_set(struct Job *jobs, int count, const char *name) {
+    char set[256];
+    for (int i = 0; i < count; i++) {
+	if (jobs[i].mode != 'c') continue;
+	remove_extension(jobs[i].file_name, set);
+	if (strcmp(set, name) == 0) return jobs + i;
+    }
+    return NULL;
+}
+
+/* -r set first-last rows: colour rows of a range of tiles in the set */
+static int paint_rows(struct Job *jobs, int count, struct Job *job) {
+    struct Tiles tiles = { NULL };
+    char name[256];
+    remove_extension(job->file_name, name);
+    struct Job *set = find_set(jobs, count, name);
+    if (set != NULL) tiles_of(set, &tiles);
+    if (tiles.color_step != 8 || job->first > job->last
+	|| job->first < 0 || job->last >= tiles.count) {
+	fprintf(stderr, "ERROR: (%s) bad rows %d-%d\n",
+		job->file_name, job->first, job->last);
+	return -EINVAL;
+    }
+    for (int i = job->first; i <= job->last; i++) {
+	memcpy(tiles.color + 8 * i, job->rows, 8);
+    }
+    return 0;
+}
+
+/* over=a,b: the set is uploaded right after the resident sets a and b */
+static void place_set(struct Job *jobs, int count, struct Job *job) {
+    struct Tiles tiles;
+    char *names = strdup(job->over);
+    job->slot = 0;
+    for (char *name = strtok(names, ","); name; name = strtok(NULL, ",")) {
+	struct Job *set = find_set(jobs, count, name);
+	if (set == NULL || set == job) {
+	    fprintf(stderr, "ERROR: (%s) bad over=%s\n", job->file_name, name);
+	    exit(-1);
+	}
+	tiles_of(set, &tiles);
+	job->slot += tiles.count;
+    }
+    free(names);
+    tiles_of(job, &tiles);
+    if (job->slot + tiles.count > 256) {
+	fprintf(stderr, "ERROR: (%s) slot %d too high\n",
+		job->file_name, job->slot);
+	exit(-1);
+    }
+}
+
+/* MSX colour rows go out as count, colour pairs, most tiles repeat
+   one colour down all eight rows and the runs carry on across tiles */
+static void pack_rows(struct Blob *blob) {
+    unsigned char *runs = malloc(2 * blob->size);
+    int size = 0;
+    for (int i = 0; i < blob->size; i++) {
+	if (size > 0 && runs[size - 1] == blob->data[i] && runs[size - 2] < 255) {
+	    runs[size - 2]++;
+	    continue;
+	}
+	runs[size++] = 1;
+	runs[size++] = blob->data[i];
+    }
+    free(blob->data);
+    blob->data = runs;
+    blob->size = size;
+}
+
+static int for_target(char *word, int target) {
+    int size = strlen(word) - 1;
+    if (size <= 0 || word[size] != ':') return 1;
+    const char *name = targets[target].name;
+    return strncmp(word, name, size) == 0 && name[size] == 0;
+}
+
+struct Line {
+    char *prefix;
+    char *argv[5];
+    int argc;
+};
+
+static int read_manifest(const char *manifest, struct Line **lines) {
+    FILE *f = fopen(manifest, "r");
+    if (f == NULL) {
+	fprintf(stderr, "ERROR while opening manifest \"%s\"\n", manifest);
+	return -ENOENT;
+    }
+
+    int count = 0, size = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+	struct Line next = { NULL };
+	char *word = strtok(line, " \t\r\n");
+	if (word != NULL && word[strlen(word) - 1] == ':') {
+	    next.prefix = strdup(word);
+	    word = strtok(NULL, " \t\r\n");
+	}
+	while (word != NULL && word[0] != '#' && next.argc < 5) {
+	    next.argv[next.argc++] = strdup(word);
+	    word = strtok(NULL, " \t\r\n");
+	}
+	if (next.argc == 0) continue;
+	if (next.argc < 2 || next.argv[0][0] != '-'
+	    || !strchr("clsr", next.argv[0][1])) {
+	    fprintf(stderr, "ERROR: (%s) bad job \"%s\"\n",
+		    manifest, next.argv[0]);
+	    return -EINVAL;
+	}
+	if (count == size) {
+	    size = size ? size * 2 : 32;
+	    *lines = realloc(*lines, size * sizeof(struct Line));
+	}
+	(*lines)[count++] = next;
+    }
+    fclose(f);
+    return count;
+}
+
+static FILE *open_output(const char *dir, const char *name) {
+    char path[512];
+    print_name(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, "w");
+    if (f == NULL) fprintf(stderr, "ERROR while creating \"%s\"\n", path);
+    return f;
+}
+
+/* data.h and assets of one target go to stdout or dir/<target>/ */
+static int emit_target(struct Job *jobs, int count, int target,
+		       const char *dir, int banked) {
+    const struct Target *t = targets + target;
+    struct Banks banks = { NULL };
+    char path[512];
+    FILE *out = stdout, *as = NULL;
+
+    if (banked && t->bank_size == 0) {
+	fprintf(stderr, "ERROR: banked builds are only for SMS, MSX and C64\n");
+	return -EINVAL;
+    }
+    if (banked && dir == NULL) {
+	fprintf(stderr, "ERROR: banked builds need an asset directory\n");
+	return -EINVAL;
+    }
+    if (banked && layout_banks(jobs, count, t, &banks) < 0) return -EFBIG;
+    if (dir != NULL) {
+	mkdir(dir, 0755);
+	print_name(path, sizeof(path), "%s/%s", dir, t->name);
+	mkdir(path, 0755);
+	out = open_output(path, "data.h");
+	as = open_output(path, "assets.s");
+	if (out == NULL || as == NULL) return -ENOENT;
+	fprintf(as, "\t.area %s\n", target == T_C64 ? "CODE" : "_CODE");
+    }
+    for (int i = 0; i < count; i++) {
+	if (jobs[i].over != NULL) {
+	    char name[256];
+	    remove_extension(jobs[i].file_name, name);
+	    fprintf(out, "#define %s_slot %d\n", name, jobs[i].slot);
+	}
+	for (int j = 0; j < jobs[i].blobs; j++) {
+	    if (banked && jobs[i].bank > 0) {
+		emit_banked(out, jobs[i].blob + j, t, &banks);
+	    }
+	    else if (as != NULL) {
+		emit_binary(out, as, path, jobs[i].blob + j);
+	    }
+	    else {
+		emit_text(out, jobs[i].blob + j);
+	    }
+	}
+    }
+    if (as != NULL) {
+	fclose(as);
+	fclose(out);
+    }
+    if (banked) {
+	save_banks(path, t, &banks);
+	free(banks.data);
+    }
+    return 0;
+}
+
+static int batch(const char *manifest, const char *dir,
+		 int *list, int lists, int banked) {
+    struct Line *lines = NULL;
+    int total = read_manifest(manifest, &lines);
+    if (total < 0) return total;
+
+    int count = 0;
+    int first[TARGETS + 1];
+    struct Job *jobs = malloc(lists * total * sizeof(struct Job));
+    for (int k = 0; k < lists; k++) {
+	first[k] = count;
+	for (int i = 0; i < total; i++) {
+	    struct Line *line = lines + i;
+	    if (line->prefix && !for_target(line->prefix, list[k])) continue;
+	    parse_job(jobs + count++, list[k], line->argc, line->argv);
+	}
+    }
+    first[lists] = count;
+
+    /* tilesets come before levels */
+    int stages[2] = { 0, 0 };
+    struct Job *stage[2][count];
+    for (int k = 0; k < lists; k++) {
+	struct Job *tileset = NULL;
+	for (int i = first[k]; i < first[k + 1]; i++) {
+	    struct Job *job = jobs + i;
+	    if (job->mode == 'r') continue;
+	    if (job->mode == 's') {
+		stage[0][stages[0]++] = job;
+		continue;
+	    }
+	    if (job->mode == 'c') {
+		tileset = job;
+		stage[0][stages[0]++] = job;
+	    }
+	    else {
+		job->tileset = tileset;
+		stage[1][stages[1]++] = job;
+	    }
 	}
     }
 
-    if (zx_color) {
-	for (i = 0; i < unpacked_size; i++) {
-	    pixels[i] = get_color(buf + palette_offset + (pixels[i] * 3));
+    if (run_stage(stage[0], stages[0]) < 0) return -ENOENT;
+    for (int k = 0; k < lists; k++) {
+	int n = first[k + 1] - first[k];
+	for (int i = first[k]; i < first[k + 1]; i++) {
+	    if (jobs[i].mode != 'r') continue;
+	    if (paint_rows(jobs + first[k], n, jobs + i) < 0) return -EINVAL;
+	}
+	for (int i = first[k]; i < first[k + 1]; i++) {
+	    if (jobs[i].mode != 'c' || jobs[i].over == NULL) continue;
+	    place_set(jobs + first[k], n, jobs + i);
+	}
+	for (int i = first[k]; i < first[k + 1]; i++) {
+	    if (jobs[i].mode != 'c' || jobs[i].blobs < 2) continue;
+	    if (row_colors(list[k])) pack_rows(jobs[i].blob + 1);
 	}
-	tile_idx = malloc(unpacked_size * sizeof(int) / 64);
-	tile_count = 0;
     }
+    if (run_stage(stage[1], stages[1]) < 0) return -ENOENT;
 
-    free(buf);
-    return pixels;
+    for (int k = 0; k < lists; k++) {
+	int n = first[k + 1] - first[k];
+	int ret = emit_target(jobs + first[k], n, list[k], dir, banked);
+	if (ret < 0) return ret;
+    }
+    return 0;
+}
+
+static void save_tileset_bin(struct Tileset *set) {
+    int fd = open("tileset.bin", O_CREAT | O_RDWR, 0644);
+    if (fd >= 0) {
+	write(fd, &set->pixel_size, sizeof(int));
+	write(fd, set->pixel, set->pixel_size);
+	write(fd, &set->color_size, sizeof(int));
+	write(fd, set->color, set->color_size);
+	close(fd);
+    }
+}
+
+static int load_tileset_bin(struct Tileset *set) {
+    int fd = open("tileset.bin", O_RDONLY, 0644);
+    if (fd < 0) return -ENOENT;
+    read(fd, &set->pixel_size, sizeof(int));
+    set->pixel = malloc(set->pixel_size);
+    read(fd, set->pixel, set->pixel_size);
+    read(fd, &set->color_size, sizeof(int));
+    set->color = malloc(set->color_size);
+    read(fd, set->color, set->color_size);
+    close(fd);
+    return 0;
+}
+
+static int parse_targets(char *names, int *list) {
+    int lists = 0;
+    for (char *name = strtok(names, ","); name; name = strtok(NULL, ",")) {
+	int i = 0;
+	while (i < TARGETS && strcmp(targets[i].name, name) != 0) i++;
+	if (i == TARGETS) {
+	    fprintf(stderr, "ERROR: unknown target \"%s\"\n", name);
+	    return -EINVAL;
+	}
+	list[lists++] = i;
+    }
+    return lists;
 }
 
 int main(int argc, char **argv) {
+    int list[TARGETS] = { T_ZXS };
+    int lists = 1, banked = 0;
+    while (argc > 2 && argv[1][0] == '-' && strchr("tB", argv[1][1])) {
+	if (argv[1][1] == 'B') {
+	    banked = 1;
+	}
+	else if ((lists = parse_targets(argv[2], list)) <= 0) {
+	    return -EINVAL;
+	}
+	else {
+	    argc--;
+	    argv++;
+	}
+	argc--;
+	argv++;
+    }
+
     if (argc < 3) {
-	printf("USAGE: pcx-dump [option] file.pcx [no-color]\n");
+	printf("USAGE: pcx-dump [-t targets] [-B] [option] file.pcx [no-color] [flip]\n");
 	printf("  -c   save tileset zx\n");
 	printf("  -l   save level zx\n");
 	printf("  -s   save tiles sega\n");
+	printf("  -r   tileset first-last c0,c1,..c7 colour rows of tiles (MSX)\n");
+	printf("flip lets SMS tilesets only drawn by maps fold flipped tiles\n");
+	printf("bank=N groups data into a switchable bank (-B)\n");
+	printf("  -b   run jobs listed in manifest file [asset-dir]\n");
+	printf("with asset-dir each target goes to asset-dir/TARGET/data.h,\n");
+	printf("binary files and assets.s\n");
+	printf("  -t   comma separated ZXS,SMS,MSX,C64 targets, ZXS by default\n");
+	printf("  -B   banked build for SMS, MSX and C64 targets\n");
+	printf("results are cached in %s/\n", cache_dir);
 	return 0;
     }
 
-    file_name = argv[2];
+    build_id = hash_file(0xcbf29ce484222325ull, "/proc/self/exe");
 
-    if (argv[1][1] == 's') {
-	save_sms_tileset();
-	return 0;
+    if (argv[1][1] == 'b') {
+	const char *dir = argc >= 4 ? argv[3] : NULL;
+	if (dir == NULL && lists > 1) {
+	    fprintf(stderr, "ERROR: several targets need an asset directory\n");
+	    return -EINVAL;
+	}
+	return batch(argv[2], dir, list, lists, banked);
     }
 
-    unsigned char *buf = read_pcx(file_name, 1);
-    if (buf == NULL) return -ENOENT;
+    struct Job job, tileset;
+    parse_job(&job, list[0], argc - 1, argv + 1);
 
-    if (argc >= 4 && strcmp(argv[3], "no-color") == 0) {
-	need_color = 0;
+    if (job.mode == 'l') {
+	if (load_tileset_bin(&tileset.set) < 0) {
+	    fprintf(stderr, "ERROR: missing tileset.bin\n");
+	    return -ENOENT;
+	}
+	job.tileset = &tileset;
     }
+    job_key(&job);
 
-    switch (argv[1][1]) {
-    case 'l':
-	as_level = 1;
-	break;
-    case 'c':
-	need_compress = 1;
-	break;
+    if (run_job(&job) < 0) return -ENOENT;
+    for (int i = 0; i < job.blobs; i++) {
+	emit_text(stdout, job.blob + i);
     }
 
-    save_bitmap(buf, header.w * header.h);
-    free(tile_idx);
-    free(buf);
+    if (job.mode == 'c') {
+	save_tileset_bin(&job.set);
+    }
     return 0;
 }
@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef unsigned char byte;
+typedef unsigned short word;
+
+#include "terrain.h"
+
+static byte walkable(byte cell) {
+    return cell == G_HUNTER || cell == G_GRASS
+	|| cell == G_DEER || cell == G_SAND;
+}
+
+/* every open cell, and so every grazer, can be reached by the hunter */
+static int solvable(byte *map) {
+    word stack[T_CELLS];
+    byte seen[T_CELLS];
+    int top = 0, open = 0, reached = 0;
+
+    memset(seen, 0, sizeof(seen));
+    for (int n = 0; n < T_CELLS; n++) {
+	if (walkable(map[n])) open++;
+	if (map[n] == G_HUNTER) {
+	    stack[top++] = n;
+	    seen[n] = 1;
+	}
+    }
+    while (top > 0) {
+	int n = stack[--top];
+	int next[4] = { n - 32, n + 32, n - 1, n + 1 };
+	reached++;
+	for (int i = 0; i < 4; i++) {
+	    int k = next[i];
+	    if (k >= 0 && k < T_CELLS && !seen[k] && walkable(map[k])) {
+		stack[top++] = k;
+		seen[k] = 1;
+	    }
+	}
+    }
+    return reached == open;
+}
+
+static void print_map(byte *map) {
+    for (int n = 0; n < T_CELLS; n++) {
+	byte cell = map[n];
+	char c = '#';
+	switch (cell) {
+	case G_HUNTER: c = '@'; break;
+	case G_GRASS: c = '.'; break;
+	case G_DEER: c = 'd'; break;
+	case G_ROCK: c = 'o'; break;
+	case G_SAND: c = ':'; break;
+	}
+	putchar(c);
+	if ((n & 31) == 31) putchar('\n');
+    }
+}
+
+/* usage: terrain walls sand rocks deer [count] [-p] */
+int main(int argc, char **argv) {
+    if (argc < 5) {
+	printf("usage: %s walls sand rocks deer [count] [-p]\n", argv[0]);
+	return -1;
+    }
+
+    struct Terrain t;
+    t.walls = atoi(argv[1]);
+    t.sand = atoi(argv[2]);
+    t.rocks = atoi(argv[3]);
+    t.deer = atoi(argv[4]);
+
+    int count = argc > 5 ? atoi(argv[5]) : 8;
+    int print = argc > 6 && strcmp(argv[6], "-p") == 0;
+
+    byte map[T_CELLS];
+    for (int seed = 1; seed < 0x10000 && count > 0; seed++) {
+	t.seed = seed;
+	terrain(map, &t);
+	if (solvable(map)) {
+	    printf("SEED=[%04x]\n", seed);
+	    if (print) print_map(map);
+	    count--;
+	}
+    }
+    return 0;
+}
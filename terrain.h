@@ -0,0 +1,116 @@
+/* seeded fenced meadows, shared by main.c and the terrain seed search */
+
+#define FLIP_H		0x20
+#define FLIP_V		0x40
+
+#define F_CORNER	0x0e
+#define F_EDGE		0x0f
+#define F_POST		0x18
+#define F_CAP		0x19
+#define F_TEE		0x1c
+
+#define G_HUNTER	0x01
+#define G_GRASS		0x02
+#define G_DEER		0x03
+#define G_ROCK		0x04
+#define G_SAND		0x06
+
+#define T_CELLS		0x2e0
+#define T_TRIES		8	/* spots tried for each wall */
+
+struct Terrain {
+    word seed;
+    byte walls;
+    byte sand;
+    byte rocks;
+    byte deer;
+};
+
+static word terrain_rnd;
+static word terrain_next(void) {
+    word x = terrain_rnd;
+    x ^= x << 7;
+    x ^= x >> 9;
+    x ^= x << 8;
+    return terrain_rnd = x;
+}
+
+static word terrain_spot(byte *map) {
+    for (;;) {
+	word n = terrain_next() & 0x3ff;
+	if (n < T_CELLS && map[n] == G_GRASS) return n;
+    }
+}
+
+static byte terrain_clear(byte *map, word n, byte length) {
+    for (byte i = 0; i < length; i++, n += 32) {
+	if (n >= T_CELLS || map[n - 1] != G_GRASS
+	    || map[n] != G_GRASS || map[n + 1] != G_GRASS) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+static byte terrain_wall(byte *map) {
+    word n = terrain_spot(map);
+    byte length = 3 + (terrain_next() & 15);
+    if ((terrain_next() & 1) && n < 0x80) {
+	length += n >> 5;
+	n = n & 31;
+    }
+    if (n < 32) {
+	if (!terrain_clear(map, n + 32, length + 1)) return 0;
+	map[n] = F_TEE | FLIP_V;
+    }
+    else if (terrain_clear(map, n - 32, length + 1)) {
+	map[n] = F_CAP;
+	length--;
+    }
+    else {
+	return 0;
+    }
+    while (--length) {
+	n += 32;
+	map[n] = F_POST;
+    }
+    map[n + 32] = F_CAP | FLIP_V;
+    return 1;
+}
+
+static void terrain(byte *map, const struct Terrain *t) {
+    terrain_rnd = t->seed ? t->seed : 1;
+    for (word n = 0; n < T_CELLS; n++) {
+	byte x = n & 31;
+	byte y = n >> 5;
+	byte cell = G_GRASS;
+	if (x == 0 || x == 31) cell = F_POST;
+	if (y == 0) cell = F_EDGE;
+	if (y == 22) cell = F_EDGE | FLIP_H | FLIP_V;
+	map[n] = cell;
+    }
+    map[0x000] = F_CORNER;
+    map[0x01f] = F_CORNER | FLIP_H;
+    map[0x2c0] = F_CORNER | FLIP_V;
+    map[0x2df] = F_CORNER | FLIP_H | FLIP_V;
+
+    /* a wall that does not fit is tried elsewhere, up to T_TRIES times */
+    byte walls = 0;
+    for (word i = 0; walls < t->walls && i < t->walls * T_TRIES; i++) {
+	walls += terrain_wall(map);
+    }
+    for (byte i = 0; i < t->sand; i++) {
+	word n = terrain_spot(map);
+	map[n] = G_SAND;
+	if (map[n - 1] == G_GRASS) map[n - 1] = G_SAND;
+	if (map[n + 1] == G_GRASS) map[n + 1] = G_SAND;
+	if (map[n + 32] == G_GRASS) map[n + 32] = G_SAND;
+    }
+    for (byte i = 0; i < t->rocks; i++) {
+	map[terrain_spot(map)] = G_ROCK;
+    }
+    for (byte i = 0; i < t->deer; i++) {
+	map[terrain_spot(map)] = G_DEER;
+    }
+    map[terrain_spot(map)] = G_HUNTER;
+}
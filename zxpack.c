@@ -0,0 +1,219 @@
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+
+const char *file = "grazers.bin";
+const char *pack = "grazers.zx";
+
+#define ORIGIN		0x8000
+#define UNPACK		0x5b00
+#define MIN_MATCH	4
+#define MAX_MATCH	129
+#define MAX_LITERAL	128
+
+/*
+ * stream: t < 0x80 literal of t + 1 bytes, t == 0x80 end,
+ * t > 0x80 match of (t & 0x7f) + 2 bytes at 16-bit LE distance back
+ */
+static unsigned char unpacker[] = {
+    0x7e,		/* next: ld a, (hl)	*/
+    0x23,		/* inc hl		*/
+    0xfe, 0x80,		/* cp #0x80		*/
+    0x28, 0x23,		/* jr z, done		*/
+    0x30, 0x08,		/* jr nc, match		*/
+    0x4f,		/* ld c, a		*/
+    0x06, 0x00,		/* ld b, #0		*/
+    0x03,		/* inc bc		*/
+    0xed, 0xb0,		/* ldir			*/
+    0x18, 0xf0,		/* jr next		*/
+    0xe6, 0x7f,		/* match: and #0x7f	*/
+    0xc6, 0x02,		/* add a, #2		*/
+    0x4f,		/* ld c, a		*/
+    0x06, 0x00,		/* ld b, #0		*/
+    0xe5,		/* push hl		*/
+    0x7e,		/* ld a, (hl)		*/
+    0x23,		/* inc hl		*/
+    0x66,		/* ld h, (hl)		*/
+    0x6f,		/* ld l, a		*/
+    0xd5,		/* push de		*/
+    0xeb,		/* ex de, hl		*/
+    0xb7,		/* or a			*/
+    0xed, 0x52,		/* sbc hl, de		*/
+    0xd1,		/* pop de		*/
+    0xed, 0xb0,		/* ldir			*/
+    0xe1,		/* pop hl		*/
+    0x23,		/* inc hl		*/
+    0x23,		/* inc hl		*/
+    0x18, 0xd7,		/* jr next		*/
+    0xc3, 0x00, 0x00,	/* done: jp entry	*/
+};
+
+/* moves the stream to the top of memory and unpacker to UNPACK */
+static unsigned char loader[] = {
+    0xf3,		/* di			*/
+    0x21, 0x00, 0x00,	/* ld hl, stream end	*/
+    0x11, 0xff, 0xff,	/* ld de, #0xffff	*/
+    0x01, 0x00, 0x00,	/* ld bc, stream size	*/
+    0xed, 0xb8,		/* lddr			*/
+    0x21, 0x00, 0x00,	/* ld hl, unpacker	*/
+    0x11, 0x00, 0x00,	/* ld de, UNPACK	*/
+    0x01, 0x00, 0x00,	/* ld bc, unpacker size	*/
+    0xed, 0xb0,		/* ldir			*/
+    0x21, 0x00, 0x00,	/* ld hl, stream start	*/
+    0x11, 0x00, 0x00,	/* ld de, ORIGIN	*/
+    0xc3, 0x00, 0x00,	/* jp UNPACK		*/
+};
+
+static void put_word(unsigned char *ptr, int value) {
+    ptr[0] = value & 0xff;
+    ptr[1] = value >> 8;
+}
+
+static int file_size(const char *name) {
+    struct stat st;
+    if (stat(name, &st) != 0) {
+	printf("ERROR \"%s\" not found\n", name);
+	exit(-ENOENT);
+    }
+    return st.st_size;
+}
+
+static void load(const char *name, unsigned char *buf, int size) {
+    int in = open(name, O_RDONLY);
+    if (in < 0 || read(in, buf, size) != size) {
+	printf("ERROR \"%s\" could not be read\n", name);
+	exit(-EIO);
+    }
+    close(in);
+}
+
+static void store(int fd, unsigned char *buf, int size) {
+    if (write(fd, buf, size) != size) {
+	printf("ERROR \"%s\" could not be written\n", pack);
+	exit(-EIO);
+    }
+}
+
+static int longest_match(unsigned char *buf, int i, int size, int *dist) {
+    int best = 0;
+    int limit = size - i < MAX_MATCH ? size - i : MAX_MATCH;
+    for (int j = i - 1; j >= 0 && i - j < 0x10000; j--) {
+	int n = 0;
+	while (n < limit && buf[j + n] == buf[i + n]) n++;
+	if (n > best) {
+	    best = n;
+	    *dist = i - j;
+	    if (n == limit) break;
+	}
+    }
+    return best;
+}
+
+static int flush(unsigned char *out, int n, unsigned char *lit, int count) {
+    if (count > 0) {
+	out[n++] = count - 1;
+	memcpy(out + n, lit, count);
+	n += count;
+    }
+    return n;
+}
+
+static int compress(unsigned char *buf, int size, unsigned char *out) {
+    int n = 0, i = 0, count = 0;
+    while (i < size) {
+	int dist = 0;
+	int len = longest_match(buf, i, size, &dist);
+	if (len >= MIN_MATCH) {
+	    n = flush(out, n, buf + i - count, count);
+	    out[n++] = 0x80 | (len - 2);
+	    put_word(out + n, dist);
+	    n += 2;
+	    count = 0;
+	    i += len;
+	}
+	else {
+	    i++;
+	    if (++count == MAX_LITERAL) {
+		n = flush(out, n, buf + i - count, count);
+		count = 0;
+	    }
+	}
+    }
+    n = flush(out, n, buf + i - count, count);
+    out[n++] = 0x80;
+    return n;
+}
+
+/* unpack in place exactly as the loader does, never overtaking input */
+static int verify(unsigned char *buf, int size, unsigned char *out, int n) {
+    unsigned char *mem = calloc(0x10000, 1);
+    int src = 0x10000 - n, dst = ORIGIN, ok = 1;
+    memcpy(mem + src, out, n);
+    for (;;) {
+	unsigned char t = mem[src++];
+	if (t == 0x80) break;
+	if (t < 0x80) {
+	    for (int i = 0; i <= t; i++) mem[dst++] = mem[src++];
+	}
+	else {
+	    int from = dst - (mem[src] | (mem[src + 1] << 8));
+	    src += 2;
+	    for (int i = 0; i < (t & 0x7f) + 2; i++) mem[dst++] = mem[from++];
+	}
+	if (dst > src) ok = 0;
+    }
+    ok = ok && dst == ORIGIN + size && memcmp(mem + ORIGIN, buf, size) == 0;
+    free(mem);
+    return ok;
+}
+
+/* usage: zxpack entry */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+	printf("usage: %s entry\n", argv[0]);
+	return -1;
+    }
+
+    int size = file_size(file);
+    unsigned char *buf = malloc(size);
+    unsigned char *out = malloc(2 * size + 16);
+
+    load(file, buf, size);
+
+    int n = compress(buf, size, out);
+    if (!verify(buf, size, out, n)) {
+	printf("ERROR \"%s\" does not unpack in place\n", file);
+	exit(-EINVAL);
+    }
+
+    int stream = ORIGIN + sizeof(loader) + sizeof(unpacker);
+    put_word(loader + 2, stream + n - 1);
+    put_word(loader + 8, n);
+    put_word(loader + 13, ORIGIN + sizeof(loader));
+    put_word(loader + 16, UNPACK);
+    put_word(loader + 19, sizeof(unpacker));
+    put_word(loader + 24, 0x10000 - n);
+    put_word(loader + 27, ORIGIN);
+    put_word(loader + 30, UNPACK);
+    put_word(unpacker + sizeof(unpacker) - 2, strtol(argv[1], NULL, 16));
+
+    printf("PACK=[%d -> %d]\n", size, n);
+
+    int fd = open(pack, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (fd < 0) {
+	printf("ERROR \"%s\" could not be created\n", pack);
+	exit(-EIO);
+    }
+    store(fd, loader, sizeof(loader));
+    store(fd, unpacker, sizeof(unpacker));
+    store(fd, out, n);
+    close(fd);
+
+    free(out);
+    free(buf);
+    return 0;
+}